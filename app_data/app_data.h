@@ -1,17 +1,16 @@
 #ifndef APP_DATA_H
 #define APP_DATA_H
 
-#include <QVariant>
 #include <vector>
 
-using data_vector_type = std::vector<double>;
+#include "data_column.h"
 
 /**
  * XY data of application to work with
  */
 class xy_data
 {
-    data_vector_type x_, y_, w_;
+    data_column x_, y_, w_;
 public:
 
     xy_data(){}
@@ -21,12 +20,48 @@ public:
           x_(x), y_(y), w_(w)
     {}
 
-    const data_vector_type& x() const { return x_; }
-    const data_vector_type& y() const { return y_; }
-    const data_vector_type& w() const { return w_;}
-    data_vector_type& x() { return x_; }
-    data_vector_type& y() { return y_; }
-    data_vector_type& w() { return w_; }
+    xy_data(const data_column& x, const data_column& y, const data_column& w)
+        :
+          x_(x), y_(y), w_(w)
+    {}
+
+    const data_column& x() const { return x_; }
+    const data_column& y() const { return y_; }
+    const data_column& w() const { return w_;}
+    data_vector_type& x() { return x_.values(); }
+    data_vector_type& y() { return y_.values(); }
+    data_vector_type& w() { return w_.values(); }
+
+    /**
+     * Stores x values as a uniform grid if it reproduces them up to rounding, see math::uniform_grid,
+     * and y values as runs of non-zero values if it takes less than a half of the dense storage
+     */
+    void compact()
+    {
+        double start, step;
+        if(x_.type() == data_column::DENSE
+                && data_column::uniform_step(x_.data(), x_.size(), start, step))
+            x_ = data_column::uniform(start, step, x_.size());
+
+        if(y_.type() == data_column::DENSE)
+        {
+            const double* y = y_.data();
+            size_t nonzeros = 0, runs = 0;
+            for(size_t i = 0; i < y_.size(); ++i)
+            {
+                if(y[i] == 0.0) continue;
+                nonzeros++;
+                if(i == 0 || y[i-1] == 0.0) runs++;
+            }
+            if(data_column::sparse_memory(nonzeros, runs) < y_.size() * sizeof(double) / 2)
+                y_ = data_column::sparse(y_.data(), y_.size());
+        }
+    }
+
+    /**
+     * Memory in bytes used by the data columns
+     */
+    size_t memory_size() const { return x_.memory_size() + y_.memory_size() + w_.memory_size(); }
 };
 
 #endif // APP_DATA_H
@@ -0,0 +1,216 @@
+#include "binary_format.h"
+#include "data_column.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    const std::size_t header_size = sizeof(binary_format::file_header);
+
+    inline std::uint64_t align(std::uint64_t offset)
+    {
+        const std::uint64_t a = binary_format::column_alignment;
+        return (offset + a - 1) / a * a;
+    }
+
+    inline std::uint64_t header_checksum(const binary_format::file_header& header)
+    {
+        return binary_format::checksum(&header, offsetof(binary_format::file_header, header_checksum));
+    }
+
+    template<typename T> inline T swap_bytes(T val)
+    {
+        char* p = reinterpret_cast<char*>(&val);
+        std::reverse(p, p + sizeof(T));
+        return val;
+    }
+
+    /**
+     * Header fields are stored in little-endian byte order, the conversion is symmetric
+     */
+    binary_format::file_header to_little_endian(binary_format::file_header header)
+    {
+        if(binary_format::host_is_little_endian()) return header;
+        header.version = swap_bytes(header.version);
+        header.flags = swap_bytes(header.flags);
+        header.points = swap_bytes(header.points);
+        header.x_start = swap_bytes(header.x_start);
+        header.x_step = swap_bytes(header.x_step);
+        for(int i = 0; i < 3; ++i)
+        {
+            header.offsets[i] = swap_bytes(header.offsets[i]);
+            header.checksums[i] = swap_bytes(header.checksums[i]);
+        }
+        header.header_checksum = swap_bytes(header.header_checksum);
+        return header;
+    }
+
+    /**
+     * Writes a column in little-endian byte order and pads it up to the alignment
+     */
+    bool write_column(std::ofstream& file, const double* data, std::size_t n)
+    {
+        if(binary_format::host_is_little_endian())
+            file.write(reinterpret_cast<const char*>(data), n * sizeof(double));
+        else
+        {
+            const std::size_t block = 1 << 16;
+            std::vector<double> buffer(block);
+            for(std::size_t i = 0; i < n; i += block)
+            {
+                std::size_t m = std::min(block, n - i);
+                for(std::size_t j = 0; j < m; ++j) buffer[j] = swap_bytes(data[i + j]);
+                file.write(reinterpret_cast<const char*>(buffer.data()), m * sizeof(double));
+            }
+        }
+        const char zeros[binary_format::column_alignment] = {};
+        std::uint64_t size = n * sizeof(double);
+        file.write(zeros, align(size) - size);
+        return file.good();
+    }
+}
+
+std::uint64_t binary_format::checksum(const void* data, std::size_t size)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::uint64_t a = 0, b = 0, word;
+    for(; size >= sizeof(word); size -= sizeof(word), p += sizeof(word))
+    {
+        std::memcpy(&word, p, sizeof(word));
+        a += word;
+        b += a;
+    }
+    if(size)
+    {
+        word = 0;
+        std::memcpy(&word, p, size);
+        a += word;
+        b += a;
+    }
+    return a ^ (b << 1 | b >> 63);
+}
+
+bool binary_format::write_file
+(
+    const std::string& file_name,
+    const double* x,
+    const double* y,
+    const double* w,
+    std::size_t n,
+    std::string& error
+)
+{
+    file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.points = n;
+    if(w) header.flags |= HAS_WEIGHTS;
+    if(data_column::uniform_step(x, n, header.x_start, header.x_step)) header.flags |= UNIFORM_X;
+    else header.x_start = n ? x[0] : 0.0;
+
+    const double* columns[3] = { x, y, w };
+    std::uint64_t offset = align(header_size);
+    for(int i = 0; i < 3; ++i)
+    {
+        if(!columns[i]) continue;
+        header.offsets[i] = offset;
+        offset = align(offset + n * sizeof(double));
+        if(host_is_little_endian())
+            header.checksums[i] = checksum(columns[i], n * sizeof(double));
+        else
+        {
+            std::vector<double> le(columns[i], columns[i] + n);
+            for(double& val : le) val = swap_bytes(val);
+            header.checksums[i] = checksum(le.data(), n * sizeof(double));
+        }
+    }
+
+    header = to_little_endian(header);
+    header.header_checksum = header_checksum(header);
+    if(!host_is_little_endian()) header.header_checksum = swap_bytes(header.header_checksum);
+
+    std::ofstream file(file_name.c_str(), std::ios::binary | std::ios::trunc);
+    if(!file)
+    {
+        error = "Fail to open file: " + file_name + ".";
+        return false;
+    }
+
+    //A partial file is removed, so e.g. a full disk never leaves a truncated spectrum
+    const char zeros[column_alignment] = {};
+    file.write(reinterpret_cast<const char*>(&header), header_size);
+    file.write(zeros, align(header_size) - header_size);
+    bool written = file.good();
+    for(int i = 0; written && i < 3; ++i)
+        if(columns[i]) written = write_column(file, columns[i], n);
+    file.close();
+    if(!written || !file.good())
+    {
+        std::remove(file_name.c_str());
+        error = "Fail to write file: " + file_name + ".";
+        return false;
+    }
+    return true;
+}
+
+bool binary_format::read_header(const void* data, std::size_t size, file_header& header, std::string& error)
+{
+    if(size < header_size)
+    {
+        error = "File is too short for a binary spectrum.";
+        return false;
+    }
+    std::memcpy(&header, data, header_size);
+    if(std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+    {
+        error = "File is not a binary spectrum.";
+        return false;
+    }
+    if(header_checksum(header) != to_little_endian(header).header_checksum)
+    {
+        error = "Binary spectrum header is corrupted.";
+        return false;
+    }
+    header = to_little_endian(header);
+    if(header.version != version)
+    {
+        error = "Unsupported binary spectrum version.";
+        return false;
+    }
+    for(int i = 0; i < 3; ++i)
+    {
+        if(i == W_COLUMN && !(header.flags & HAS_WEIGHTS)) continue;
+        //Bounds are compared without sums, so huge values of a damaged header do not overflow
+        if(header.offsets[i] % column_alignment != 0 || header.offsets[i] > size
+                || header.points > (size - header.offsets[i]) / sizeof(double))
+        {
+            error = "Binary spectrum file is truncated.";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool binary_format::verify_columns(const void* data, const file_header& header)
+{
+    for(int i = 0; i < 3; ++i)
+    {
+        if(i == W_COLUMN && !(header.flags & HAS_WEIGHTS)) continue;
+        if(checksum(column(data, header, column_index(i)), header.points * sizeof(double)) != header.checksums[i])
+            return false;
+    }
+    return true;
+}
+
+bool binary_format::host_is_little_endian()
+{
+    const std::uint16_t probe = 1;
+    return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+}
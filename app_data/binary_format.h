@@ -0,0 +1,88 @@
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Native binary spectrum format. The file starts with a header followed by 64 bytes aligned
+ * little-endian x, y and w columns of doubles, so the columns can be used right from a mapped file
+ */
+namespace binary_format
+{
+    const char magic[8] = { 'M', 'P', 'S', 'P', 'E', 'C', '\0', '\1' };
+    const std::uint32_t version = 1;
+    const std::size_t column_alignment = 64;
+
+    enum header_flags
+    {
+        HAS_WEIGHTS = 0x01, ///w column is stored
+        UNIFORM_X = 0x02    ///x values are x_start + x_step * index
+    };
+
+    enum column_index
+    {
+        X_COLUMN = 0,
+        Y_COLUMN = 1,
+        W_COLUMN = 2
+    };
+
+    struct file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t flags;
+        std::uint64_t points;
+        double x_start;
+        double x_step;
+        std::uint64_t offsets[3];       ///columns offsets from the file beginning
+        std::uint64_t checksums[3];     ///columns checksums
+        std::uint64_t header_checksum;  ///checksum of all preceding header fields
+    };
+
+    /**
+     * Fletcher-like checksum over 64-bit words, a tail is padded with zeros
+     */
+    std::uint64_t checksum(const void* data, std::size_t size);
+
+    /**
+     * Writes columns into a binary file, w can be null. Returns false and sets error on failure
+     */
+    bool write_file
+    (
+        const std::string& file_name,
+        const double* x,
+        const double* y,
+        const double* w,
+        std::size_t n,
+        std::string& error
+    );
+
+    /**
+     * Checks the header of a binary file of the given size placed in memory at data,
+     * columns are checked to lie within the file but their checksums are verified by verify_columns
+     */
+    bool read_header(const void* data, std::size_t size, file_header& header, std::string& error);
+
+    /**
+     * Pointer to a column of a file placed in memory at data
+     */
+    inline const double* column(const void* data, const file_header& header, column_index idx)
+    {
+        return reinterpret_cast<const double*>(static_cast<const char*>(data) + header.offsets[idx]);
+    }
+
+    /**
+     * Verifies columns checksums, it touches whole file so it is not a part of read_header.
+     * Loaders call it before columns are used, so corrupted data never reach fits and peak tables
+     */
+    bool verify_columns(const void* data, const file_header& header);
+
+    /**
+     * Byte order of binary columns is the same as the host one
+     */
+    bool host_is_little_endian();
+}
+
+#endif // BINARY_FORMAT_H
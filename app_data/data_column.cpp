@@ -0,0 +1,103 @@
+#include "data_column.h"
+#include "math/uniform_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+data_column data_column::uniform(double start, double step, size_t size)
+{
+    data_column column;
+    column.type_ = UNIFORM;
+    column.start_ = start;
+    column.step_ = step;
+    column.size_ = size;
+    return column;
+}
+
+data_column data_column::sparse(const double* values, size_t n)
+{
+    data_column column;
+    column.type_ = SPARSE;
+    column.size_ = n;
+    for(size_t i = 0; i < n; )
+    {
+        if(values[i] == 0.0) { ++i; continue; }
+        column.run_begins_.push_back(i);
+        column.run_offsets_.push_back(column.run_values_.size());
+        for(; i < n && values[i] != 0.0; ++i) column.run_values_.push_back(values[i]);
+    }
+    column.run_offsets_.push_back(column.run_values_.size());
+    column.run_begins_.shrink_to_fit();
+    column.run_offsets_.shrink_to_fit();
+    column.run_values_.shrink_to_fit();
+    return column;
+}
+
+bool data_column::uniform_step(const double* values, size_t n, double& start, double& step)
+{
+    return math::uniform_grid(values, n, start, step);
+}
+
+data_column::size_t data_column::sparse_memory(size_t nonzeros, size_t runs)
+{
+    return nonzeros * sizeof(double) + (2 * runs + 1) * sizeof(size_t);
+}
+
+const double* data_column::data() const
+{
+    switch(type_)
+    {
+    case DENSE: return values_.data();
+    case VIEW: return data_;
+    default: return nullptr;
+    }
+}
+
+data_column::size_t data_column::lower_index(double x) const
+{
+    if(empty()) return 0;
+    if(type_ == UNIFORM)
+    {
+        double idx = std::floor((x - start_) / step_);
+        return idx <= 0.0 ? 0 : std::min(size_ - 1, size_t(idx));
+    }
+    const_iterator it = std::upper_bound(begin(), end(), x);
+    return it == begin() ? 0 : it.index() - 1;
+}
+
+data_vector_type& data_column::values()
+{
+    if(type_ != DENSE) *this = data_column(to_vector());
+    return values_;
+}
+
+data_column::size_t data_column::memory_size() const
+{
+    switch(type_)
+    {
+    case DENSE: return values_.capacity() * sizeof(double);
+    case VIEW: return 0;
+    case UNIFORM: return 0;
+    default: return sparse_memory(run_values_.capacity(), run_begins_.capacity());
+    }
+}
+
+double data_column::sparse_value(size_t idx, size_t& run) const
+{
+    const size_t nruns = run_begins_.size();
+    if(nruns == 0 || idx < run_begins_[0]) return 0.0;
+
+    //Sequential access moves to the next run, otherwise the run is searched
+    auto contains = [this, nruns, idx](size_t k)
+    {
+        return k < nruns && run_begins_[k] <= idx && (k + 1 == nruns || idx < run_begins_[k+1]);
+    };
+    if(!contains(run))
+    {
+        if(contains(run + 1)) ++run;
+        else run = std::upper_bound(run_begins_.begin(), run_begins_.end(), idx) - run_begins_.begin() - 1;
+    }
+
+    const size_t offset = idx - run_begins_[run];
+    return offset < run_offsets_[run+1] - run_offsets_[run] ? run_values_[run_offsets_[run] + offset] : 0.0;
+}
@@ -0,0 +1,186 @@
+#ifndef DATA_COLUMN_H
+#define DATA_COLUMN_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+using data_vector_type = std::vector<double>;
+
+/**
+ * Column of xy data values. Values are either owned, or viewed in an external memory kept alive
+ * by a shared storage handle (e.g. a mapped file), or stored compactly as a uniform grid start + step * index
+ * or as runs of non-zero values separated by zeros
+ */
+class data_column
+{
+public:
+    using size_t = std::size_t;
+
+    enum storage_type
+    {
+        DENSE = 0x00,   ///owned vector of values
+        VIEW = 0x01,    ///external memory
+        UNIFORM = 0x02, ///uniform grid
+        SPARSE = 0x03   ///runs of non-zero values
+    };
+
+    /**
+     * Random access iterator over values of any storage type
+     */
+    class const_iterator
+    {
+        const data_column* column_;
+        size_t idx_;
+        mutable size_t run_; //hint of a current non-zero run for a sparse column
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = double;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const double*;
+        using reference = double;
+
+        const_iterator(const data_column* column = nullptr, size_t idx = 0)
+            : column_(column), idx_(idx), run_(size_t(-1)) {}
+
+        double operator*() const { return column_->value(idx_, run_); }
+        double operator[](difference_type n) const { return *(*this + n); }
+
+        const_iterator& operator++() { ++idx_; return *this; }
+        const_iterator operator++(int) { const_iterator it(*this); ++idx_; return it; }
+        const_iterator& operator--() { --idx_; return *this; }
+        const_iterator operator--(int) { const_iterator it(*this); --idx_; return it; }
+        const_iterator& operator+=(difference_type n) { idx_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { idx_ -= n; return *this; }
+        const_iterator operator+(difference_type n) const { const_iterator it(*this); return it += n; }
+        const_iterator operator-(difference_type n) const { const_iterator it(*this); return it -= n; }
+        difference_type operator-(const const_iterator& it) const { return difference_type(idx_) - difference_type(it.idx_); }
+
+        bool operator==(const const_iterator& it) const { return idx_ == it.idx_; }
+        bool operator!=(const const_iterator& it) const { return idx_ != it.idx_; }
+        bool operator<(const const_iterator& it) const { return idx_ < it.idx_; }
+        bool operator>(const const_iterator& it) const { return idx_ > it.idx_; }
+        bool operator<=(const const_iterator& it) const { return idx_ <= it.idx_; }
+        bool operator>=(const const_iterator& it) const { return idx_ >= it.idx_; }
+
+        size_t index() const { return idx_; }
+    };
+
+    data_column() : type_(DENSE), data_(nullptr), size_(0), start_(0.0), step_(0.0) {}
+
+    data_column(const data_vector_type& values)
+        :
+          type_(DENSE), values_(values), data_(nullptr), size_(0), start_(0.0), step_(0.0)
+    {}
+
+    data_column(data_vector_type&& values)
+        :
+          type_(DENSE), values_(std::move(values)), data_(nullptr), size_(0), start_(0.0), step_(0.0)
+    {}
+
+    /**
+     * Creates a view of size values at data, storage keeps the memory alive
+     */
+    data_column(std::shared_ptr<const void> storage, const double* data, size_t size)
+        :
+          type_(VIEW), storage_(storage), data_(data), size_(size), start_(0.0), step_(0.0)
+    {}
+
+    /**
+     * Creates a column of size values start + step * index
+     */
+    static data_column uniform(double start, double step, size_t size);
+
+    /**
+     * Creates a column of n values keeping only runs of non-zero values
+     */
+    static data_column sparse(const double* values, size_t n);
+
+    /**
+     * Detects if n values lie on a uniform grid start + step * index, see math::uniform_grid
+     */
+    static bool uniform_step(const double* values, size_t n, double& start, double& step);
+
+    /**
+     * Memory in bytes needed to keep n values with the given number of non-zero values and runs sparse
+     */
+    static size_t sparse_memory(size_t nonzeros, size_t runs);
+
+    storage_type type() const { return type_; }
+    bool is_view() const { return type_ == VIEW; }
+    bool is_uniform() const { return type_ == UNIFORM; }
+    bool is_sparse() const { return type_ == SPARSE; }
+
+    /**
+     * Uniform grid parameters
+     */
+    double start() const { return start_; }
+    double step() const { return step_; }
+
+    size_t size() const { return type_ == DENSE ? values_.size() : size_; }
+    bool empty() const { return size() == 0; }
+
+    /**
+     * Pointer to contiguous values of a dense column or a view, null for a compact column
+     */
+    const double* data() const;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    double operator[](size_t idx) const { size_t run = size_t(-1); return value(idx, run); }
+    double front() const { return (*this)[0]; }
+    double back() const { return (*this)[size() - 1]; }
+
+    /**
+     * Index of the last value which is not greater than x for sorted values, zero if there is no such value.
+     * Constant time for a uniform column
+     */
+    size_t lower_index(double x) const;
+
+    /**
+     * Copies values into a new dense vector, a compact column is expanded
+     */
+    data_vector_type to_vector() const { return data_vector_type(begin(), end()); }
+
+    /**
+     * Values for modification, the column becomes dense
+     */
+    data_vector_type& values();
+
+    /**
+     * Memory in bytes used by the column values
+     */
+    size_t memory_size() const;
+
+private:
+    storage_type type_;
+    data_vector_type values_;               //owned values
+    std::shared_ptr<const void> storage_;
+    const double* data_;
+    size_t size_;
+    double start_, step_;
+    std::vector<size_t> run_begins_;        //index of the first value of every non-zero run
+    std::vector<size_t> run_offsets_;       //offsets of runs in run_values_ and the total number of values
+    data_vector_type run_values_;
+
+    /**
+     * Value at idx, run is a hint of a sparse run containing idx which is updated
+     */
+    double value(size_t idx, size_t& run) const
+    {
+        switch(type_)
+        {
+        case DENSE: return values_[idx];
+        case VIEW: return data_[idx];
+        case UNIFORM: return start_ + step_ * idx;
+        default: return sparse_value(idx, run);
+        }
+    }
+
+    double sparse_value(size_t idx, size_t& run) const;
+};
+
+#endif // DATA_COLUMN_H
@@ -1,7 +1,16 @@
 #include "data_export.h"
+#include "binary_format.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
 #include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <memory>
 
 #define DEF_ASSERT_FILE_NAME(name)\
     if(name.isEmpty()) Q_EMIT this->error("Could not convert constructor params to string.");
@@ -13,6 +22,31 @@
         return; \
     }
 
+data_exporter::data_exporter()
+    :
+      m_bStreaming(false),
+      m_bAborted(false),
+      m_pBlockSink(this)
+{
+}
+
+void data_exporter::push_block(data_block&& block)
+{
+    //The consumer may be gone when loading is aborted, so the block is dropped
+    while(!m_pBlockSink->m_Blocks.try_push(std::move(block)))
+    {
+        if(aborted()) return;
+        QThread::yieldCurrentThread();
+    }
+    Q_EMIT m_pBlockSink->block_ready();
+}
+
+void data_exporter::redirect_blocks(data_exporter* pInner)
+{
+    pInner->m_pBlockSink = this;
+    pInner->m_bStreaming = m_bStreaming;
+}
+
 load_data_from_ascii_file::load_data_from_ascii_file(QVariant params)
     :
       file_name_(params.toString())
@@ -97,11 +131,225 @@ void LoadCsv::run()
     }
 }
 
+LoadMappedText::LoadMappedText(QVariant params, const text_parser::text_format& format)
+    :
+      m_strFileName(params.toString()),
+      m_format(format),
+      m_bCompact(true)
+{
+    DEF_ASSERT_FILE_NAME(m_strFileName)
+    this->setAutoDelete(false);
+}
+
+void LoadMappedText::run()
+{
+    QFile file(m_strFileName);
+    DEF_READ_ASSERT(file.open(QIODevice::ReadOnly), QString("Fail to open file: ") + m_strFileName + ".")
+
+    m_DataPtr.reset(new xy_data);
+    Q_EMIT this->progress_val(0);
+
+    const qint64 nSize = file.size();
+    if(nSize == 0)
+    {
+        Q_EMIT this->progress_val(100);
+        return;
+    }
+
+    uchar* pMap = file.map(0, nSize);
+    DEF_READ_ASSERT(pMap, QString("Fail to map file: ") + m_strFileName + ".")
+    const char* pBegin = reinterpret_cast<const char*>(pMap);
+    const char* pEnd = pBegin + nSize;
+
+    text_parser::columns cols;
+    text_parser::parse_error err;
+    int nProgress = 0;
+    auto progress = [this, nSize, &nProgress](size_t nBytes)
+    {
+        int nVal = int(100 * double(nBytes) / nSize);
+        if(nVal != nProgress) Q_EMIT this->progress_val(nProgress = nVal);
+    };
+
+    if(this->streaming())
+    {
+        //Sequential parsing by small blocks, so the first points are available almost immediately
+        const size_t nBlockSize = 1 << 20;
+        err = text_parser::parse_columns_blocks(pBegin, pEnd, m_format, cols, nBlockSize,
+            [this, &progress](const text_parser::columns& block, size_t nBytes) -> bool
+        {
+            data_block b;
+            b.x = block.x;
+            b.y = block.y;
+            this->push_block(std::move(b));
+            progress(nBytes);
+            return !this->aborted();
+        });
+    }
+    else
+    {
+        err = text_parser::parse_columns_parallel(pBegin, pEnd, m_format, cols, 0, progress);
+    }
+    file.unmap(pMap);
+
+    m_DataPtr->x().swap(cols.x);
+    m_DataPtr->y().swap(cols.y);
+    m_DataPtr->w().swap(cols.w);
+    if(m_bCompact) m_DataPtr->compact();
+
+    DEF_READ_ASSERT(err.type != text_parser::parse_error::TEXT_LINE,
+        (QString("Text information in file: ") + m_strFileName + " on line %1.").arg(err.line))
+    DEF_READ_ASSERT(err.type != text_parser::parse_error::COLUMNS_NUMBER,
+        QString("Number of columns at line %1 is %2.").arg(err.line).arg(err.columns))
+}
+
+LoadBinary::LoadBinary(QVariant params)
+    :
+      m_strFileName(params.toString())
+{
+    DEF_ASSERT_FILE_NAME(m_strFileName)
+    this->setAutoDelete(false);
+}
+
+void LoadBinary::run()
+{
+    //The file is kept open while its columns are in use, closing the file unmaps it
+    std::shared_ptr<QFile> pFile(new QFile(m_strFileName));
+    DEF_READ_ASSERT(pFile->open(QIODevice::ReadOnly), QString("Fail to open file: ") + m_strFileName + ".")
+
+    m_DataPtr.reset(new xy_data);
+    Q_EMIT this->progress_val(0);
+
+    const qint64 nSize = pFile->size();
+    const uchar* pMap = nSize ? pFile->map(0, nSize) : Q_NULLPTR;
+    DEF_READ_ASSERT(pMap, QString("Fail to map file: ") + m_strFileName + ".")
+
+    binary_format::file_header header;
+    std::string strError;
+    DEF_READ_ASSERT(binary_format::read_header(pMap, size_t(nSize), header, strError),
+                    QString::fromStdString(strError) + " File: " + m_strFileName + ".")
+
+    //Whole data are read for the plot pyramid anyway, so columns are verified before they are used
+    DEF_READ_ASSERT(binary_format::verify_columns(pMap, header),
+                    QString("Binary spectrum data are corrupted. File: ") + m_strFileName + ".")
+
+    const size_t N = header.points;
+    const bool bWeights = header.flags & binary_format::HAS_WEIGHTS;
+    const double* pX = binary_format::column(pMap, header, binary_format::X_COLUMN);
+    const double* pY = binary_format::column(pMap, header, binary_format::Y_COLUMN);
+    const double* pW = bWeights ? binary_format::column(pMap, header, binary_format::W_COLUMN) : Q_NULLPTR;
+
+    //Implicit uniform x values are not read from the file at all
+    const bool bUniform = header.flags & binary_format::UNIFORM_X;
+    if(binary_format::host_is_little_endian())
+    {
+        *m_DataPtr = xy_data(bUniform ? data_column::uniform(header.x_start, header.x_step, N)
+                                      : data_column(pFile, pX, N),
+                             data_column(pFile, pY, N),
+                             bWeights ? data_column(pFile, pW, N) : data_column());
+    }
+    else
+    {
+        auto swapped = [N](const double* p) -> data_vector_type
+        {
+            data_vector_type v(p, p + N);
+            for(double& val : v) std::reverse(reinterpret_cast<char*>(&val), reinterpret_cast<char*>(&val + 1));
+            return v;
+        };
+        *m_DataPtr = xy_data(bUniform ? data_column::uniform(header.x_start, header.x_step, N)
+                                      : data_column(swapped(pX)),
+                             data_column(swapped(pY)),
+                             data_column(bWeights ? swapped(pW) : data_vector_type()));
+    }
+
+    Q_EMIT this->progress_val(100);
+}
+
+LoadCachedText::LoadCachedText(QVariant params, const text_parser::text_format& format)
+    :
+      m_strFileName(params.toString()),
+      m_format(format)
+{
+    DEF_ASSERT_FILE_NAME(m_strFileName)
+    this->setAutoDelete(false);
+}
+
+QString LoadCachedText::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/spectra";
+}
+
+void LoadCachedText::run()
+{
+    QFileInfo info(m_strFileName);
+    const QString strKey = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(),
+                                                    QCryptographicHash::Sha1).toHex();
+    const QString strCacheName = QString("%1/%2-%3-%4.mps")
+            .arg(cacheDir()).arg(strKey).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+
+    if(QFile::exists(strCacheName))
+    {
+        //A broken cache is silently replaced
+        bool bFailed = false;
+        LoadBinary binary(strCacheName);
+        connect(&binary, &data_exporter::error, [&bFailed](QString){ bFailed = true; });
+        binary.run();
+        if(!bFailed)
+        {
+            m_DataPtr = binary.data_ptr();
+            Q_EMIT this->progress_val(100);
+            return;
+        }
+        QFile::remove(strCacheName);
+    }
+
+    bool bFailed = false;
+    LoadMappedText text(m_strFileName, m_format);
+    text.set_compact(false);
+    this->redirect_blocks(&text);
+    connect(&text, &data_exporter::error, this, &data_exporter::error, Qt::DirectConnection);
+    connect(&text, &data_exporter::progress_val, this, &data_exporter::progress_val, Qt::DirectConnection);
+    connect(&text, &data_exporter::error, [&bFailed](QString){ bFailed = true; });
+    text.run();
+    m_DataPtr = text.data_ptr();
+    if(!m_DataPtr || aborted()) return;
+
+    //The cache keeps parsed values, so columns are compacted after it is written.
+    //Weights given only for a part of rows are not supported by the binary format
+    const xy_data& data = *m_DataPtr;
+    if(!bFailed && (data.w().empty() || data.w().size() == data.x().size())) writeCache(strKey, strCacheName);
+    m_DataPtr->compact();
+}
+
+void LoadCachedText::writeCache(const QString& strKey, const QString& strCacheName) const
+{
+    //Caches of previous versions of the file are replaced
+    QDir dir(cacheDir());
+    if(!dir.mkpath(".")) return;
+    for(const QString& strOld : dir.entryList(QStringList() << strKey + "-*.mps", QDir::Files))
+        dir.remove(strOld);
+
+    const xy_data& data = *m_DataPtr;
+    const QString strTempName = strCacheName + ".tmp";
+    std::string strError;
+    if(binary_format::write_file(QFile::encodeName(strTempName).toStdString(),
+                                 data.x().data(), data.y().data(),
+                                 data.w().empty() ? Q_NULLPTR : data.w().data(),
+                                 data.x().size(), strError))
+        QFile::rename(strTempName, strCacheName);
+    else
+        QFile::remove(strTempName);
+}
+
 data_exporter* data_export_factory::create_data_exporter(DATA_EXPORT_TYPE type, QVariant params)
 {
     switch (type) {
     case ASCII_FILE: return new load_data_from_ascii_file(params);
     case CSV_FILE: return new LoadCsv(params);
+    case MAPPED_ASCII_FILE: return new LoadMappedText(params, text_parser::tab_separated);
+    case MAPPED_CSV_FILE: return new LoadMappedText(params, text_parser::comma_separated);
+    case BINARY_FILE: return new LoadBinary(params);
+    case CACHED_ASCII_FILE: return new LoadCachedText(params, text_parser::tab_separated);
+    case CACHED_CSV_FILE: return new LoadCachedText(params, text_parser::comma_separated);
     default: return Q_NULLPTR;
     }
 }
@@ -2,26 +2,81 @@
 #define DATA_EXPORT_H
 
 #include "app_data.h"
+#include "spsc_queue.h"
+#include "text_parser.h"
 
 #include <QRunnable>
 #include <QVariant>
 #include <QSharedPointer>
 
+#include <atomic>
+
 enum DATA_EXPORT_TYPE
 {
     ASCII_FILE = 0x00,
     CSV_FILE = 0x01,
+    MAPPED_ASCII_FILE = 0x02,
+    MAPPED_CSV_FILE = 0x03,
+    BINARY_FILE = 0x04,
+    CACHED_ASCII_FILE = 0x05,
+    CACHED_CSV_FILE = 0x06,
     DATA_EXPORT_UNKNOWN = 0xFF
 };
 
+/**
+ * Block of points parsed by a streaming exporter
+ */
+struct data_block
+{
+    data_vector_type x, y;
+};
+
 class data_exporter : public QObject, public QRunnable
 {
     Q_OBJECT
 public:
+    data_exporter();
+
     virtual QSharedPointer<xy_data> data_ptr() = 0;
 
+    /**
+     * In the streaming mode blocks of parsed points are passed to a consumer while loading, see block_ready
+     */
+    void set_streaming(bool bStreaming) { m_bStreaming = bStreaming; }
+    bool streaming() const { return m_bStreaming; }
+
+    /**
+     * Takes the next parsed block, must be called from a single consumer thread
+     */
+    bool pop_block(data_block& block) { return m_Blocks.try_pop(block); }
+
+    /**
+     * Stops loading from any thread: a push of a block waiting for the consumer returns,
+     * parsing stops after the current block and loaded data are partial
+     */
+    void abort() { m_bAborted = true; }
+    bool aborted() const { return m_pBlockSink->m_bAborted; }
+
     Q_SIGNAL void error(QString error_msg);
     Q_SIGNAL void progress_val(int val);
+    Q_SIGNAL void block_ready();
+
+protected:
+    /**
+     * Passes a parsed block to the consumer, waits while the queue is full unless loading is aborted
+     */
+    void push_block(data_block&& block);
+
+    /**
+     * Blocks of a nested exporter are passed through the queue of this one
+     */
+    void redirect_blocks(data_exporter* pInner);
+
+private:
+    bool m_bStreaming;
+    std::atomic<bool> m_bAborted;
+    data_exporter* m_pBlockSink;
+    spsc_queue<data_block> m_Blocks;
 };
 
 /**
@@ -70,6 +125,96 @@ public:
     void run();
 };
 
+/**
+ * Loads delimited text file by mapping it into memory and parsing numbers directly from the mapped bytes.
+ * Newline aligned chunks of the file are parsed on all cores
+ */
+class LoadMappedText : public data_exporter
+{
+    QString m_strFileName;
+    text_parser::text_format m_format;
+    QSharedPointer<xy_data> m_DataPtr;
+    bool m_bCompact;
+
+public:
+    LoadMappedText(QVariant params, const text_parser::text_format& format);
+    ~LoadMappedText(){}
+
+    /**
+     * Parsed columns are compacted by default, otherwise they are left as parsed
+     */
+    void set_compact(bool bCompact) { m_bCompact = bCompact; }
+
+    /**
+     * Get loaded data
+     */
+    QSharedPointer<xy_data> data_ptr() { return m_DataPtr; }
+
+    /**
+     * Runs file loading process
+     */
+    void run();
+};
+
+/**
+ * Loads native binary spectrum file. Columns are not parsed, xy_data refers to the mapped file
+ */
+class LoadBinary : public data_exporter
+{
+    QString m_strFileName;
+    QSharedPointer<xy_data> m_DataPtr;
+
+public:
+    LoadBinary(QVariant params);
+    ~LoadBinary(){}
+
+    /**
+     * Get loaded data
+     */
+    QSharedPointer<xy_data> data_ptr() { return m_DataPtr; }
+
+    /**
+     * Runs file loading process
+     */
+    void run();
+};
+
+/**
+ * Loads delimited text file through a binary cache. The cache is keyed by the file path, size and
+ * modification time, it is written after the first parsing of the file and loaded instead of it later
+ */
+class LoadCachedText : public data_exporter
+{
+    QString m_strFileName;
+    text_parser::text_format m_format;
+    QSharedPointer<xy_data> m_DataPtr;
+
+public:
+    LoadCachedText(QVariant params, const text_parser::text_format& format);
+    ~LoadCachedText(){}
+
+    /**
+     * Get loaded data
+     */
+    QSharedPointer<xy_data> data_ptr() { return m_DataPtr; }
+
+    /**
+     * Runs file loading process
+     */
+    void run();
+
+    /**
+     * Directory where binary caches are stored
+     */
+    static QString cacheDir();
+
+private:
+    /**
+     * Writes parsed columns into the cache replacing caches of previous versions of the file
+     */
+    void writeCache(const QString& strKey, const QString& strCacheName) const;
+};
+
 /**
  * Data export factory
  */
@@ -2,6 +2,8 @@
 #define ARRAY_OPERATIONS_H
 
 #include <cstddef>
+#include <algorithm>
+#include <iterator>
 
 namespace math {
     /**
@@ -97,5 +99,23 @@ namespace math {
         static inline void Do(operation /*Op*/, T ...){}
     };
 
+    /**
+     * Looks for the first element in the sorted range [first, last) which is not less than val
+     * by steps doubling from the beginning of the range. When sorted values are looked for
+     * one after another starting from the previous result, the search walks along the range
+     * in linear time overall and still takes logarithmic time for sparse values
+     */
+    template<typename iterator, typename T>
+    iterator gallop_lower_bound(iterator first, iterator last, const T& val)
+    {
+        typename std::iterator_traits<iterator>::difference_type step = 1;
+        while(last - first > step && *(first + (step - 1)) < val)
+        {
+            first += step;
+            step *= 2;
+        }
+        return std::lower_bound(first, last - first > step ? first + step : last, val);
+    }
+
 } //end of math namespace
 #endif // ARRAY_OPERATIONS_H
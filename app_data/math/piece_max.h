@@ -0,0 +1,36 @@
+#ifndef PIECE_MAX_H
+#define PIECE_MAX_H
+
+#include <cmath>
+
+namespace math {
+    /**
+     * Finds a maximum in (0, h] of a polynomial piece a*t^3 + b*t^2 + c*t + d of degree up to three,
+     * a is zero for a quadratic. The derivative 3a*t^2 + 2b*t + c is solved in closed form
+     * @return false if the piece has no maximum there
+     */
+    template<typename Float>
+    inline bool piece_max(Float a, Float b, Float c, Float h, Float& t)
+    {
+        //Derivative is A*t^2 + B*t + C
+        const Float A = 3 * a;
+        const Float B = 2 * b;
+        const Float C = c;
+
+        //Most pieces are rejected without roots: there is no sign change of the derivative
+        //from plus to minus at the ends and no extremum of the derivative inside the piece
+        const bool sign_change = (C > 0) & ((A*h + B)*h + C <= 0);
+        const bool vertex_inside = (A != 0) & (A*C >= 0) & (-B*A > 0) & (-B*A < 2*A*A*h);
+        if(!(sign_change | vertex_inside)) return false;
+
+        //The derivative changes its sign from plus to minus at the root (-B - sqrt(D))/(2A) only,
+        //the second derivative there is -sqrt(D). The form without cancellation is chosen by sign of B
+        const Float D = B*B - 4*A*C;
+        if(D <= 0) return false;
+        const Float s = std::sqrt(D);
+        t = B <= 0 ? 2*C / (s - B) : -(B + s) / (2*A);
+        return t > 0 && t <= h;
+    }
+}
+
+#endif // PIECE_MAX_H
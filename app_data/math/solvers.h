@@ -2,7 +2,14 @@
 #define SOLVERS_H
 
 #include <memory>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include <algorithm>
+#include <atomic>
+
+#include "thread_pool.h"
 
 namespace math
 {
@@ -34,7 +41,8 @@ namespace math
         return 0;
     }
     /**
-     * Solves five diagonal linear equation system with a symmetric matrix, no error checking supported
+     * Solves five diagonal linear equation system with a symmetric matrix, no error checking supported.
+     * It changes b, d and r, the main diagonal c is replaced by inverses of its eliminated values
      */
     template<class DataType> void fivediagonalsolve
         (
@@ -48,10 +56,12 @@ namespace math
             DataType* x     //solution
         ) noexcept
     {
+        //Inverse pivots are kept in c, so every row takes a single division
         for(int i = 0; i < n-2; i++)
         {
-            DataType m1 = b[i]/c[i];
-            DataType m2 = a[i]/c[i];
+            c[i] = DataType(1) / c[i];
+            DataType m1 = b[i]*c[i];
+            DataType m2 = a[i]*c[i];
             c[i+1] = c[i+1] - m1*d[i];
             d[i+1] = d[i+1] - m1*e[i];
             b[i+1] = b[i+1] - m2*d[i];
@@ -59,16 +69,402 @@ namespace math
             r[i+1] = r[i+1] - m1*r[i];
             r[i+2] = r[i+2] - m2*r[i];
         }
-        DataType m3 = b[n-2]/c[n-2];
+        c[n-2] = DataType(1) / c[n-2];
+        DataType m3 = b[n-2]*c[n-2];
         c[n-1] = c[n-1] - m3*d[n-2];
         r[n-1] = r[n-1] - m3*r[n-2];
         x[n-1] = r[n-1] / c[n-1];
-        x[n-2] = (r[n-2] - d[n-2]*x[n-1]) / c[n-2];
+        x[n-2] = (r[n-2] - d[n-2]*x[n-1]) * c[n-2];
 
         for(int i = n-3; i >= 0; i--)
-            x[i] = (r[i] - d[i]*x[i+1] - e[i]*x[i+2]) / c[i];
+            x[i] = (r[i] - d[i]*x[i+1] - e[i]*x[i+2]) * c[i];
     }
 
+    /**
+     * LDL^T factorisation of a symmetric banded matrix with Band diagonals above the main one.
+     * The matrix is factored once and is not changed by solutions, so a single factorisation
+     * serves any number of right-hand parts, no error checking supported
+     */
+    template<typename Float, size_t Band = 2>
+    class banded_ldlt
+    {
+        size_t n_;
+        std::vector<Float> d_, id_;  //pivots and their inverses
+        std::vector<Float> l_;       //L(i,i-k) is kept at l_[i*Band + k-1]
+
+    public:
+        banded_ldlt() : n_(0) {}
+
+        /**
+         * Factors the matrix of size n, diags[k][i] = A(i,i+k) = A(i+k,i) for 0 <= k <= Band,
+         * the k-th diagonal holds n-k values
+         */
+        banded_ldlt(size_t n, const Float* const* diags)
+            :
+              n_(n),
+              d_(n),
+              id_(n),
+              l_(n * Band)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                const size_t band = std::min(i, Band);
+                Float* li = l_.data() + i*Band;
+                for(size_t k = band; k >= 1; --k)
+                {
+                    const size_t j = i - k;
+                    const Float* lj = l_.data() + j*Band;
+                    Float s = diags[k][j];
+                    for(size_t m = k+1; m <= band; ++m)
+                        s -= li[m-1] * lj[m-k-1] * d_[i-m];
+                    li[k-1] = s * id_[j];
+                }
+                Float s = diags[0][i];
+                for(size_t k = 1; k <= band; ++k)
+                    s -= li[k-1] * li[k-1] * d_[i-k];
+                d_[i] = s;
+                id_[i] = Float(1) / s;
+            }
+        }
+
+        /**
+         * Size of the matrix
+         */
+        size_t size() const { return n_; }
+
+        /**
+         * Pivot D(i,i)
+         */
+        Float pivot(size_t i) const { return d_[i]; }
+
+        /**
+         * Element L(i+k,i) of the k-th subdiagonal of L, it is zero out of the matrix
+         */
+        Float lower(size_t i, size_t k) const { return i + k < n_ ? l_[(i+k)*Band + k-1] : Float(0); }
+
+        /**
+         * Replaces nrhs right-hand parts by solutions. They are interleaved: x[i*nrhs + j] is
+         * the i-th value of the j-th part, so every elimination step is a contiguous loop
+         * over all parts, which is vectorised by a compiler
+         */
+        void solve(Float* x, size_t nrhs = 1) const
+        {
+            forward(x, nrhs);
+            backward(x, nrhs);
+        }
+
+        /**
+         * First half of solve(): replaces interleaved right-hand parts r by D^-1*L^-1*r
+         */
+        void forward(Float* x, size_t nrhs = 1) const
+        {
+            const size_t n = n_;
+            for(size_t i = 0; i < n; ++i)
+            {
+                Float* xi = x + i*nrhs;
+                const Float* li = l_.data() + i*Band;
+                for(size_t k = 1; k <= std::min(i, Band); ++k)
+                {
+                    const Float* xk = x + (i-k)*nrhs;
+                    const Float lik = li[k-1];
+                    for(size_t j = 0; j < nrhs; ++j) xi[j] -= lik * xk[j];
+                }
+            }
+            for(size_t i = 0; i < n; ++i)
+            {
+                Float* xi = x + i*nrhs;
+                const Float idi = id_[i];
+                for(size_t j = 0; j < nrhs; ++j) xi[j] *= idi;
+            }
+        }
+
+        /**
+         * Second half of solve(): replaces interleaved parts z by L^-T*z
+         */
+        void backward(Float* x, size_t nrhs = 1) const
+        {
+            const size_t n = n_;
+            for(size_t i = n; i-- > 0; )
+            {
+                Float* xi = x + i*nrhs;
+                for(size_t k = 1; k <= Band && i + k < n; ++k)
+                {
+                    const Float* xk = x + (i+k)*nrhs;
+                    const Float lki = l_[(i+k)*Band + k-1];
+                    for(size_t j = 0; j < nrhs; ++j) xi[j] -= lki * xk[j];
+                }
+            }
+        }
+    };
+
+    /**
+     * Symmetric banded system partitioned for concurrent solution in the way of SPIKE solvers.
+     * Blocks of rows are separated by Band rows, every block is factored and solved by a task of thread_pool.
+     * Coupling of blocks through the separators is resolved by a small reduced system on separator rows,
+     * which depends only on corners of inverse block matrices. A result equals the one of banded_ldlt
+     * up to rounding errors, no error checking supported
+     */
+    template<typename Float, size_t Band = 2>
+    class partitioned_ldlt
+    {
+        struct block
+        {
+            size_t first, size;
+            banded_ldlt<Float, Band> factor;
+            Float etop[Band][Band];  //A(first+a, first-Band+s), coupling of top rows with the left separator
+            Float ebot[Band][Band];  //A(first+size-Band+a, first+size+s), coupling of bottom rows with the right one
+        };
+
+        std::vector<block> blocks_;
+        banded_ldlt<Float, 2*Band - 1> reduced_;  //Schur complement on separator rows
+
+        /**
+         * Calls fun(i) for every block concurrently by threads of the pool
+         */
+        template<class Fun>
+        void for_blocks_(Fun fun) const
+        {
+            thread_pool::instance().for_each(blocks_.size(), fun);
+        }
+
+        /**
+         * Factors a block and finds top-left, top-right and bottom-right corners of its inverse matrix
+         */
+        void factor_block_(block& bl, const Float* const* diags, Float* corners) const
+        {
+            const size_t m = bl.size;
+            const Float* bd[Band+1];
+            for(size_t k = 0; k <= Band; ++k) bd[k] = diags[k] + bl.first;
+            bl.factor = banded_ldlt<Float, Band>(m, bd);
+            const banded_ldlt<Float, Band>& f = bl.factor;
+            Float (*ctt)[Band] = reinterpret_cast<Float(*)[Band]>(corners);
+            Float (*ctb)[Band] = ctt + Band;
+            Float (*cbb)[Band] = ctb + Band;
+
+            //Central band of the inverse from the bottom (Hutchinson and de Hoog), win[p][q] = S(k+p,k+q)
+            Float win[Band+1][Band+1] = {};
+            for(size_t k = m; k-- > 0; )
+            {
+                for(size_t p = Band; p >= 1; --p)
+                    for(size_t q = Band; q >= 1; --q) win[p][q] = win[p-1][q-1];
+                for(size_t q = 1; q <= Band; ++q)
+                {
+                    Float s = 0;
+                    for(size_t t = 1; t <= Band; ++t) s -= f.lower(k, t) * win[t][q];
+                    win[0][q] = win[q][0] = s;
+                }
+                Float s = Float(1) / f.pivot(k);
+                for(size_t t = 1; t <= Band; ++t) s -= f.lower(k, t) * win[0][t];
+                win[0][0] = s;
+            }
+            for(size_t a = 0; a < Band; ++a)
+                for(size_t b = 0; b < Band; ++b) ctt[a][b] = win[a][b];
+
+            //Columns of the inverse at bottom rows, only their top and bottom values are kept
+            Float z[Band][Band] = {}, v[Band+1][Band] = {};
+            for(size_t a = 0; a < Band; ++a)
+            {
+                const size_t i = m - Band + a;
+                for(size_t s = 0; s < Band; ++s)
+                {
+                    Float val = a == s ? Float(1) : Float(0);
+                    for(size_t k = 1; k <= a; ++k) val -= f.lower(i-k, k) * z[a-k][s];
+                    z[a][s] = val;
+                }
+            }
+            Float* rows[Band+1];
+            for(size_t t = 0; t <= Band; ++t) rows[t] = v[t];
+            for(size_t i = m; i-- > 0; )
+            {
+                for(size_t s = 0; s < Band; ++s)
+                {
+                    Float val = i >= m - Band ? z[i-m+Band][s] / f.pivot(i) : Float(0);
+                    for(size_t t = 1; t <= Band; ++t) val -= f.lower(i, t) * rows[t][s];
+                    rows[0][s] = val;
+                    if(i >= m - Band) cbb[i-m+Band][s] = val;
+                    if(i < Band) ctb[i][s] = val;
+                }
+                Float* last = rows[Band];
+                for(size_t t = Band; t >= 1; --t) rows[t] = rows[t-1];
+                rows[0] = last;
+            }
+        }
+
+    public:
+        /**
+         * Minimal number of rows in a block which is solved by a separate thread, a system factored
+         * inside a loop of thread_pool gets a single block
+         */
+        static const size_t min_block_size = 1 << 16;
+
+        partitioned_ldlt(size_t n, const Float* const* diags, size_t nblocks = 0)
+        {
+            if(nblocks == 0)
+                nblocks = std::min<size_t>(thread_pool::instance().concurrency(),
+                                           std::max<size_t>(1, n / min_block_size));
+            //Every block should have separate top and bottom rows
+            nblocks = std::max<size_t>(1, std::min(nblocks, (n + Band) / (3*Band)));
+
+            const size_t interior = n - Band * (nblocks - 1);
+            blocks_.resize(nblocks);
+            for(size_t i = 0, first = 0; i < nblocks; ++i)
+            {
+                block& bl = blocks_[i];
+                bl.first = first;
+                bl.size = interior / nblocks + (i < interior % nblocks ? 1 : 0);
+                first += bl.size + Band;
+                for(size_t a = 0; a < Band; ++a)
+                    for(size_t s = 0; s < Band; ++s)
+                    {
+                        bl.etop[a][s] = i > 0 && a <= s ? diags[Band+a-s][bl.first-Band+s] : Float(0);
+                        bl.ebot[a][s] = i < nblocks-1 && s <= a ? diags[Band-a+s][bl.first+bl.size-Band+a] : Float(0);
+                    }
+            }
+
+            std::vector<Float> corners(nblocks * 3 * Band * Band);
+            for_blocks_([&](size_t i)
+            {
+                this->factor_block_(blocks_[i], diags, corners.data() + i * 3 * Band * Band);
+            });
+            if(nblocks == 1) return;
+
+            //Reduced matrix A_SS - sum A_SB*A_BB^-1*A_BS, its upper part is kept by diagonals
+            const size_t nr = Band * (nblocks - 1);
+            std::vector<std::vector<Float>> rd(2*Band, std::vector<Float>(nr));
+            for(size_t sep = 1; sep < nblocks; ++sep)
+            {
+                const size_t g = blocks_[sep].first - Band;
+                for(size_t a = 0; a < Band; ++a)
+                    for(size_t b = a; b < Band; ++b) rd[b-a][(sep-1)*Band + a] = diags[b-a][g+a];
+            }
+            for(size_t i = 0; i < nblocks; ++i)
+            {
+                const block& bl = blocks_[i];
+                const Float (*c)[Band] = reinterpret_cast<const Float(*)[Band]>(corners.data() + i * 3 * Band * Band);
+                //Left separator rows come first, bottom rows of the block couple only with the right one
+                const Float (*e[2])[Band] = { bl.etop, bl.ebot };
+                const Float (*cm[2][2])[Band] = { { c, c + Band }, { c + Band, c + 2*Band } };
+                const size_t r0[2] = { (i - 1) * Band, i * Band };
+                for(size_t u = i > 0 ? 0 : 1; u < (i < nblocks-1 ? 2u : 1u); ++u)
+                    for(size_t w = u; w < (i < nblocks-1 ? 2u : 1u); ++w)
+                        for(size_t s1 = 0; s1 < Band; ++s1)
+                            for(size_t s2 = u == w ? s1 : 0; s2 < Band; ++s2)
+                            {
+                                Float val = 0;
+                                for(size_t a = 0; a < Band; ++a)
+                                    for(size_t b = 0; b < Band; ++b)
+                                        val += e[u][a][s1] * cm[u][w][a][b] * e[w][b][s2];
+                                rd[r0[w] + s2 - r0[u] - s1][r0[u] + s1] -= val;
+                            }
+            }
+            const Float* rp[2*Band];
+            for(size_t k = 0; k < 2*Band; ++k) rp[k] = rd[k].data();
+            reduced_ = banded_ldlt<Float, 2*Band - 1>(nr, rp);
+        }
+
+        /**
+         * Number of blocks solved concurrently
+         */
+        size_t blocks() const { return blocks_.size(); }
+
+        /**
+         * Replaces nrhs interleaved right-hand parts by solutions like banded_ldlt::solve()
+         */
+        void solve(Float* x, size_t nrhs = 1) const
+        {
+            const size_t nblocks = blocks_.size();
+            if(nblocks == 1) { blocks_[0].factor.solve(x, nrhs); return; }
+
+            //Top and bottom values of block solutions are found without storing their backward sweeps
+            std::vector<Float> tips(nblocks * 2 * Band * nrhs);
+            for_blocks_([&](size_t i)
+            {
+                const block& bl = blocks_[i];
+                const size_t m = bl.size;
+                Float* xb = x + bl.first * nrhs;
+                Float* top = tips.data() + i * 2 * Band * nrhs;
+                Float* bottom = top + Band * nrhs;
+                bl.factor.forward(xb, nrhs);
+
+                std::vector<Float> v((Band + 1) * nrhs);
+                Float* rows[Band+1];
+                for(size_t t = 0; t <= Band; ++t) rows[t] = v.data() + t * nrhs;
+                for(size_t k = m; k-- > 0; )
+                {
+                    for(size_t j = 0; j < nrhs; ++j) rows[0][j] = xb[k*nrhs + j];
+                    for(size_t t = 1; t <= Band; ++t)
+                    {
+                        const Float l = bl.factor.lower(k, t);
+                        for(size_t j = 0; j < nrhs; ++j) rows[0][j] -= l * rows[t][j];
+                    }
+                    if(k >= m - Band) std::copy(rows[0], rows[0] + nrhs, bottom + (k-m+Band) * nrhs);
+                    if(k < Band) std::copy(rows[0], rows[0] + nrhs, top + k * nrhs);
+                    Float* last = rows[Band];
+                    for(size_t t = Band; t >= 1; --t) rows[t] = rows[t-1];
+                    rows[0] = last;
+                }
+            });
+
+            //Separator values from the reduced system
+            const size_t nr = Band * (nblocks - 1);
+            std::vector<Float> xs(nr * nrhs);
+            for(size_t sep = 1; sep < nblocks; ++sep)
+            {
+                const block& left = blocks_[sep-1];
+                const block& right = blocks_[sep];
+                const Float* gbot = tips.data() + ((sep-1) * 2 + 1) * Band * nrhs;
+                const Float* gtop = tips.data() + sep * 2 * Band * nrhs;
+                for(size_t s = 0; s < Band; ++s)
+                {
+                    Float* xss = xs.data() + ((sep-1) * Band + s) * nrhs;
+                    std::copy(x + (right.first - Band + s) * nrhs, x + (right.first - Band + s + 1) * nrhs, xss);
+                    for(size_t a = 0; a < Band; ++a)
+                        for(size_t j = 0; j < nrhs; ++j)
+                            xss[j] -= left.ebot[a][s] * gbot[a*nrhs + j] + right.etop[a][s] * gtop[a*nrhs + j];
+                }
+            }
+            reduced_.solve(xs.data(), nrhs);
+            for(size_t sep = 1; sep < nblocks; ++sep)
+                std::copy(xs.data() + (sep-1) * Band * nrhs, xs.data() + sep * Band * nrhs,
+                          x + (blocks_[sep].first - Band) * nrhs);
+
+            //Blocks are solved again with right-hand parts reduced by known separator values
+            for_blocks_([&](size_t i)
+            {
+                const block& bl = blocks_[i];
+                const size_t m = bl.size;
+                Float* xb = x + bl.first * nrhs;
+                const Float* xl = i > 0 ? xs.data() + (i-1) * Band * nrhs : nullptr;
+                const Float* xr = i < nblocks-1 ? xs.data() + i * Band * nrhs : nullptr;
+
+                std::vector<Float> u((Band + 1) * nrhs);
+                Float* rows[Band+1];
+                for(size_t t = 0; t <= Band; ++t) rows[t] = u.data() + t * nrhs;
+                for(size_t k = 0; k < m; ++k)
+                {
+                    std::fill(rows[0], rows[0] + nrhs, Float(0));
+                    for(size_t s = 0; s < Band; ++s)
+                        for(size_t j = 0; j < nrhs; ++j)
+                        {
+                            if(xl && k < Band) rows[0][j] += bl.etop[k][s] * xl[s*nrhs + j];
+                            if(xr && k >= m - Band) rows[0][j] += bl.ebot[k-m+Band][s] * xr[s*nrhs + j];
+                        }
+                    for(size_t t = 1; t <= std::min(k, Band); ++t)
+                    {
+                        const Float l = bl.factor.lower(k-t, t);
+                        for(size_t j = 0; j < nrhs; ++j) rows[0][j] -= l * rows[t][j];
+                    }
+                    const Float id = Float(1) / bl.factor.pivot(k);
+                    for(size_t j = 0; j < nrhs; ++j) xb[k*nrhs + j] -= rows[0][j] * id;
+                    Float* last = rows[Band];
+                    for(size_t t = Band; t >= 1; --t) rows[t] = rows[t-1];
+                    rows[0] = last;
+                }
+                bl.factor.backward(xb, nrhs);
+            });
+        }
+    };
+
     ///Solves equation fun(x) = 0 (abs(fun(x))<eps) on interval [a,b]
     /// Note, that it is supposed that function has only one zero at the interval
     /// \param fun Function
@@ -98,6 +494,301 @@ namespace math
         }
     }
 
+    template<typename Float>
+    void segmented_cubic_spline_coefficients(size_t N, Float* a, Float* b, Float* c, Float* d,
+                                             const Float* x, const Float* y, const Float* w,
+                                             Float smooth, size_t window, size_t overlap = 0);
+
+    /**
+     * Smoothing cubic spline fitting of a fixed set of points with ascending x-values.
+     * Matrices R and Q^T*W*Q of the spline equations do not depend on the smoothing parameter,
+     * they are computed once, so a fit with a new smoothing parameter only assembles,
+     * factors and solves a five diagonal system in O(N). Long systems are solved by blocks concurrently
+     */
+    template<typename Float>
+    class cubic_spline_fitter
+    {
+        std::vector<Float> x_, y_, w_;
+        std::vector<Float> h_, ih_;              //steps between x-values and their inverses
+        std::vector<Float> qwq0_, qwq1_, qwq2_;  //main and upper diagonals of Q^T*W*Q
+
+        Float w_at_(size_t i) const { return w_.empty() ? Float(1) : w_[i]; }
+
+        /**
+         * Smoothing parameter which balances both parts of the spline equations for a mean step
+         */
+        Float initial_smoothing_() const
+        {
+            Float h = (x_.back() - x_.front()) / (x_.size() - 1), w = 1;
+            if(!w_.empty()) w = std::accumulate(w_.begin(), w_.end(), Float(0)) / w_.size();
+            return w > 0 ? h*h*h / w : h*h*h;
+        }
+
+        /**
+         * Factors matrix R + smooth*Q^T*W*Q, its boundary rows keep zero second derivatives at the ends
+         */
+        template<class Factor>
+        Factor factor_(Float smooth) const
+        {
+            const size_t N = size();
+            const Float* h = h_.data();
+            std::vector<Float> m0(N), m1(N-1), m2(N-2);
+            m0[0] = m0[N-1] = 1./6.;
+            for(size_t i = 1; i < N-1; ++i)
+            {
+                m0[i] = 1./3. * (h[i-1] + h[i]) + smooth * qwq0_[i];
+                if(i < N-2)
+                {
+                    m1[i] = 1./6. * h[i] + smooth * qwq1_[i];
+                    m2[i] = smooth * qwq2_[i];
+                }
+            }
+            const Float* diags[] = { m0.data(), m1.data(), m2.data() };
+            return Factor(N, diags);
+        }
+
+        /**
+         * Calculates coefficients of nrhs interleaved sets of y-values with a factored matrix
+         */
+        template<class Factor>
+        void fit_(const Factor& factor, Float smooth, size_t nrhs,
+                  const Float* y, Float* a, Float* b, Float* c, Float* d) const
+        {
+            const size_t N = size();
+            const Float* h = h_.data();
+            const Float* ih = ih_.data();
+
+            //Second order derivatives are found from Q^T*y in place of c
+            std::fill(c, c + nrhs, Float(0));
+            std::fill(c + (N-1)*nrhs, c + N*nrhs, Float(0));
+            for(size_t i = 1; i < N-1; ++i)
+                for(size_t j = 0; j < nrhs; ++j)
+                    c[i*nrhs + j] = (y[(i+1)*nrhs + j] - y[i*nrhs + j]) * ih[i]
+                            - (y[i*nrhs + j] - y[(i-1)*nrhs + j]) * ih[i-1];
+            factor.solve(c, nrhs);
+
+            //Divisions by steps are replaced by multiplications by their inverses
+            for(size_t i = 0; i < N; ++i)
+            {
+                const Float sw = smooth * w_at_(i);
+                for(size_t j = 0; j < nrhs; ++j)
+                {
+                    const size_t k = i*nrhs + j;
+                    d[k] = i < N-1 ? (c[k+nrhs] - c[k]) * ih[i] : Float(0);
+                    a[k] = y[k] - sw * (d[k] - (i > 0 ? d[k-nrhs] : Float(0)));
+                }
+            }
+            for(size_t i = 0; i < N-1; ++i)
+                for(size_t j = 0; j < nrhs; ++j)
+                {
+                    const size_t k = i*nrhs + j;
+                    b[k] = (a[k+nrhs] - a[k]) * ih[i] - (c[k] / 2. + d[k] / 6. * h[i]) * h[i];
+                }
+            for(size_t j = 0, k = (N-2)*nrhs; j < nrhs; ++j, ++k)
+                b[k+nrhs] = b[k] + (c[k] + d[k] * h[N-2] / 2.) * h[N-2];
+        }
+
+    public:
+        /**
+         * Prepares fitting of N > 3 points, weights w multiply the smoothing parameter
+         * at every point, they are all ones if w is null
+         */
+        cubic_spline_fitter(size_t N, const Float* const x, const Float* const y, const Float* const w = nullptr)
+            :
+              x_(x, x + N),
+              y_(y, y + N),
+              h_(N),
+              ih_(N),
+              qwq0_(N),
+              qwq1_(N),
+              qwq2_(N)
+        {
+            if(w) w_.assign(w, w + N);
+            for(size_t i = 0; i < N-1; ++i)
+            {
+                h_[i] = x[i+1] - x[i];
+                ih_[i] = 1. / h_[i];
+            }
+
+            //Boundary rows stay zero, they keep zero second derivatives at the ends
+            for(size_t i = 1; i < N-1; ++i)
+            {
+                Float h1 = x[i] - x[i-1];
+                Float h2 = x[i+1] - x[i];
+
+                qwq0_[i] = 1./h1/h1 * w_at_(i-1)
+                        + (1./h1 + 1./h2)*(1./h1 + 1./h2) * w_at_(i)
+                        + 1./h2/h2 * w_at_(i+1);
+
+                if(i < N-2)
+                {
+                    Float h3 = x[i+2] - x[i+1];
+                    qwq1_[i] = - 1./h2 * ((1./h1 + 1./h2)*w_at_(i)
+                                          + (1./h2 + 1./h3)*w_at_(i+1));
+                    if(i < N-3) qwq2_[i] = 1./h2/h3 * w_at_(i+1);
+                }
+            }
+        }
+
+        /**
+         * Number of points
+         */
+        size_t size() const { return x_.size(); }
+
+        /**
+         * X-values of points
+         */
+        const std::vector<Float>& x() const { return x_; }
+
+        /**
+         * Calculates coefficients of the spline S(x) = a + b*x + c*x^2/2 + d*x^3/6
+         * with the smoothing parameter, every array holds size() values
+         */
+        void fit(Float smooth, Float* a, Float* b, Float* c, Float* d) const
+        {
+            fit_(factor_<partitioned_ldlt<Float>>(smooth), smooth, 1, y_.data(), a, b, c, d);
+        }
+
+        /**
+         * Fits nrhs sets of y-values given at the same x-values with a single factorisation.
+         * Y-values and coefficients are interleaved: y[i*nrhs + j] is the i-th value of the j-th set
+         */
+        void fit_many(Float smooth, size_t nrhs, const Float* y, Float* a, Float* b, Float* c, Float* d) const
+        {
+            fit_(factor_<partitioned_ldlt<Float>>(smooth), smooth, nrhs, y, a, b, c, d);
+        }
+
+        /**
+         * Fits overlapping windows of about window points separately like segmented_cubic_spline_coefficients,
+         * all the points are fitted at once if there are no more of them than window
+         */
+        void fit_segmented(Float smooth, Float* a, Float* b, Float* c, Float* d,
+                           size_t window, size_t overlap = 0) const
+        {
+            segmented_cubic_spline_coefficients(size(), a, b, c, d, x_.data(), y_.data(),
+                                                w_.empty() ? nullptr : w_.data(), smooth, window, overlap);
+        }
+
+        /**
+         * Calculates weighted residual sum of squares of the fit with the smoothing parameter and
+         * trace of I - A, where A maps y-values to fitted ones. Only the central band of the inverse
+         * matrix is needed for the trace (Hutchinson and de Hoog), so both take O(N)
+         */
+        void fit_statistics(Float smooth, Float& rss, Float& trace) const
+        {
+            const size_t N = size();
+            const banded_ldlt<Float> factor = factor_<banded_ldlt<Float>>(smooth);
+            std::vector<Float> a(N), b(N), c(N), d(N);
+            fit_(factor, smooth, 1, y_.data(), a.data(), b.data(), c.data(), d.data());
+            rss = 0.0;
+            for(size_t i = 0; i < N; ++i)
+                if(w_at_(i) > 0) rss += (y_[i] - a[i]) * (y_[i] - a[i]) / w_at_(i);
+
+            //Central band of the inverse matrix S from the bottom, trace(S*Q^T*W*Q) is accumulated
+            Float s00 = 0.0, s01 = 0.0, s11 = 0.0; //S(k+1,k+1), S(k+1,k+2), S(k+2,k+2)
+            Float tr = 0.0;
+            for(size_t k = N-2; k >= 1; --k)
+            {
+                const Float l1 = factor.lower(k, 1), l2 = factor.lower(k, 2);
+                Float sk2 = - l1*s01 - l2*s11;
+                Float sk1 = - l1*s00 - l2*s01;
+                Float skk = 1. / factor.pivot(k) - l1*sk1 - l2*sk2;
+                tr += skk*qwq0_[k] + 2.*(sk1*qwq1_[k] + sk2*qwq2_[k]);
+                s11 = s00;
+                s01 = sk1;
+                s00 = skk;
+            }
+            trace = smooth * tr;
+        }
+
+        /**
+         * Generalised cross validation score of the fit with the smoothing parameter
+         */
+        Float gcv(Float smooth) const
+        {
+            Float rss, trace;
+            fit_statistics(smooth, rss, trace);
+            return size() * rss / (trace * trace);
+        }
+
+        /**
+         * Smoothing parameter minimising generalised cross validation score. The minimum is bracketed
+         * by steps of ten times and then refined by golden section search over the logarithm of the parameter
+         */
+        Float gcv_smoothing() const
+        {
+            const int max_steps = 30;
+            const Float tol = 1e-3, step = std::log(10.), ratio = 0.5 * (3. - std::sqrt(5.));
+            auto score = [this](Float t) -> Float
+            {
+                Float v = this->gcv(std::exp(t));
+                return v == v ? v : std::numeric_limits<Float>::infinity();
+            };
+
+            Float tb = std::log(initial_smoothing_()), ta = tb - step, tc = tb + step;
+            Float fa = score(ta), fb = score(tb), fc = score(tc);
+            for(int i = 0; i < max_steps && (fa < fb || fc < fb); ++i)
+            {
+                if(fa < fc)
+                {
+                    tc = tb; fc = fb;
+                    tb = ta; fb = fa;
+                    ta = tb - step; fa = score(ta);
+                }
+                else
+                {
+                    ta = tb; fa = fb;
+                    tb = tc; fb = fc;
+                    tc = tb + step; fc = score(tc);
+                }
+            }
+
+            Float t1 = ta + ratio * (tc - ta), t2 = tc - ratio * (tc - ta);
+            Float f1 = score(t1), f2 = score(t2);
+            while(tc - ta > tol)
+            {
+                if(f1 < f2)
+                {
+                    tc = t2; t2 = t1; f2 = f1;
+                    t1 = ta + ratio * (tc - ta); f1 = score(t1);
+                }
+                else
+                {
+                    ta = t1; t1 = t2; f1 = f2;
+                    t2 = tc - ratio * (tc - ta); f2 = score(t2);
+                }
+            }
+            return std::exp(0.5 * (ta + tc));
+        }
+
+        /**
+         * Smoothing parameter at which weighted mean square residual equals the noise variance.
+         * Residual grows with the parameter, so it is bracketed by steps of ten times and bisected
+         */
+        Float noise_smoothing(Float noise) const
+        {
+            const int max_steps = 60;
+            const Float tol = 1e-3, step = std::log(10.), target = noise * noise * size();
+            auto residual = [this](Float t) -> Float
+            {
+                Float rss, trace;
+                this->fit_statistics(std::exp(t), rss, trace);
+                return rss;
+            };
+
+            Float lo = std::log(initial_smoothing_()), hi = lo;
+            for(int i = 0; i < max_steps && residual(lo) > target; ++i) lo -= step;
+            for(int i = 0; i < max_steps && residual(hi) < target; ++i) hi += step;
+            while(hi - lo > tol)
+            {
+                Float mid = 0.5 * (lo + hi);
+                if(residual(mid) < target) lo = mid;
+                else hi = mid;
+            }
+            return std::exp(0.5 * (lo + hi));
+        }
+    };
+
     /**
      * Calculates coefficients of a smoothing cubic spline
      * S(x) = a + b*x + c*x^2/2 + d*x^3/6
@@ -116,76 +807,207 @@ namespace math
             const Float* const w
     )
     {
-        Float h1, h2, h3;
-
-        //Set boundaries:
-        a[0] = a[N-1] = 1./6.;
-        b[0] = b[N-2] = c[0] = c[N-3] = d[0] = d[N-1] = 0.0;
-        //********************
-
-        //Set matrix values
-        for(size_t i = 1; i < N-3; ++i)
-        {
-            h1 = x[i] - x[i-1];
-            h2 = x[i+1] - x[i];
-            h3 = x[i+2] - x[i+1];
-
-            a[i] = 1./3. * (h1 + h2) + 1./h1/h1 * w[i-1]
-                    + (1./h1 + 1./h2)*(1./h1 + 1./h2) * w[i]
-                    + 1./h2/h2 * w[i+1];
-
-            d[i] = (y[i+1] - y[i]) / h2 - (y[i] - y[i-1]) / h1;
-
-            b[i] = 1./6. * h2 - 1./h2 * ((1./h1 + 1./h2)*w[i]
-                                         + (1./h2 + 1./h3)*w[i+1]);
-
-            c[i] = 1./h2/h3 * w[i+1];
-        }
-        h1 = x[N-3] - x[N-4];
-        h2 = x[N-2] - x[N-3];
-        h3 = x[N-1] - x[N-2];
-        b[N-3] = 1./6. * h2 - 1./h2 * ((1./h1 + 1./h2)*w[N-3]
-                                       + (1./h2 + 1./h3)*w[N-2]);
-        a[N-3] = 1./3. * (h1 + h2) + 1./h1/h1 * w[N-4]
-                + (1./h1 + 1./h2)*(1./h1 + 1./h2) * w[N-3]
-                + 1./h2/h2 * w[N-2];
-        d[N-3] = (y[N-2] - y[N-3]) / h2 - (y[N-3] - y[N-4]) / h1;
-        a[N-2] = 1./3. * (h2 + h3) + 1./h2/h2 * w[N-3]
-                + (1./h2 + 1./h3)*(1./h2 + 1./h3) * w[N-2]
-                + 1./h3/h3 * w[N-1];
-        d[N-2] = (y[N-1] - y[N-2]) / h3 - (y[N-2] - y[N-3]) / h2;
-
-        //duplicate values for a symmetric matrix
-        std::unique_ptr<Float[]>
-                cl(new Float[N-2]),
-                bl(new Float[N-1]),
-                c_(new Float[N]); //Preallocate to temporary keep solution
-        std::copy(c, c+N-2, cl.get());
-        std::copy(b, b+N-1, bl.get());
-        /***************/
-
-        //Calculates second order spline derivatives into c_
-        math::fivediagonalsolve(N, cl.get(), bl.get(), a, b, c, d, c_.get());
-
-        h1 = x[1] - x[0]; h2 = x[N-1] - x[N-2];
-        a[0]  = y[0]  - (c_[1] - c_[0]) / h1 * w[0];
-        a[N-1]= y[N-1]+ (c_[N-1] - c_[N-2]) / h2 * w[N-1];
-        d[0] = (c_[1] - c_[0]) / h1;
-        for(size_t i = 1; i < N-1; ++i)
-        {
-            h1 = x[i] - x[i-1];
-            h2 = x[i+1] - x[i];
-            a[i] = y[i] - w[i] * ((c_[i+1] - c_[i]) / h2
-                    - (c_[i] - c_[i-1]) / h1);
-            d[i] = (c_[i+1] - c_[i]) / h2;
-            b[i-1] = (a[i] - a[i-1]) / h1
-                    - (c_[i-1] / 2. + d[i-1] / 6. * h1) * h1;
-        }
-        h1 = x[N-1] - x[N-2];
-        b[N-2] = (a[N-1] - a[N-2]) / h1
-                - (c_[N-2] / 2. + d[N-2] / 6. * h1) * h1;
-        b[N-1] = b[N-2] + (c_[N-2] + d[N-2] * h1 / 2.) * h1;
-        std::copy(c_.get(), c_.get() + N, c);
+        cubic_spline_fitter<Float>(N, x, y, w).fit(1.0, a, b, c, d);
+    }
+
+    /**
+     * Overlap of windows of a segmented fit for a smoothing parameter, a mean step of x-values and a mean weight.
+     * Far from the ends the spline equations act on differences of second derivatives like h + smooth*w/h^2 * D^4,
+     * so an end of a window changes the fit by terms decaying like exp(-n/L) within n points,
+     * where L = sqrt(2) * (smooth*w/h^3)^(1/4). A half of the overlap separates a blend zone from the end
+     * of a window, so it takes enough decay lengths to damp the change down to rounding errors
+     */
+    template<typename Float>
+    size_t spline_overlap(Float smooth, Float h, Float w)
+    {
+        const size_t min_overlap = 16, max_overlap = std::numeric_limits<size_t>::max() / 8;
+        const Float decay_lengths = 36;
+        if(!(h > 0) || !(w > 0) || !(smooth > 0)) return min_overlap;
+        const Float length = std::sqrt(Float(2)) * std::pow(smooth * w / (h*h*h), Float(0.25));
+        const Float overlap = 2 * std::ceil(decay_lengths * length);
+        if(!(overlap < Float(max_overlap))) return max_overlap;
+        return std::max(min_overlap, size_t(overlap));
+    }
+
+    /**
+     * Blends n pieces of a left and a right spline S = a + b*t + c*t^2/2 + d*t^3/6 starting at knots x[0..n-1],
+     * left, right and out point to arrays of a, b, c and d. Values and second derivatives at knot p
+     * are weighted by 1 - p/n and p/n, the ones at x[n] are taken from the right spline, and first and third
+     * derivatives of pieces are found from them. So the blend starts as the left spline and joins the right one
+     * with continuous values and second derivatives, its first derivative jumps at knots by the difference
+     * of both splines over n at most
+     */
+    template<typename Float>
+    void blend_spline_pieces(size_t n, const Float* x, const Float* const* left, const Float* const* right,
+                             Float* const* out)
+    {
+        if(n == 0) return;
+        std::vector<Float> va(n + 1), vc(n + 1);
+        for(size_t p = 0; p < n; ++p)
+        {
+            const Float t = Float(p) / n;
+            va[p] = (1 - t) * left[0][p] + t * right[0][p];
+            vc[p] = (1 - t) * left[2][p] + t * right[2][p];
+        }
+        const size_t e = n - 1;
+        const Float he = x[n] - x[e];
+        va[n] = ((right[3][e] * he / 3 + right[2][e]) * he / 2 + right[1][e]) * he + right[0][e];
+        vc[n] = right[2][e] + right[3][e] * he;
+        for(size_t p = 0; p < n; ++p)
+        {
+            const Float h = x[p+1] - x[p];
+            out[0][p] = va[p];
+            out[1][p] = (va[p+1] - va[p]) / h - h * (2 * vc[p] + vc[p+1]) / 6;
+            out[2][p] = vc[p];
+            out[3][p] = (vc[p+1] - vc[p]) / h;
+        }
+    }
+
+    /**
+     * Cut of spline_segments ending a segment which starts at start and takes core points without overlaps,
+     * only y-values of the last quarter of the core are used, so cuts can be found while points are loaded.
+     * y points to the y-value of point base, which should not follow start
+     */
+    template<typename Float>
+    size_t spline_cut(const Float* y, size_t base, size_t start, size_t core)
+    {
+        const size_t target = start + core, min_zero_run = 2;
+        size_t cut = target, longest = 0;
+        for(size_t i = target - core/4, run = 0; i < target; ++i)
+        {
+            run = y[i - base] == Float(0) ? run + 1 : 0;
+            if(run > longest)
+            {
+                longest = run;
+                cut = i + 1 - run/2;
+            }
+        }
+        return longest >= min_zero_run ? cut : target;
+    }
+
+    /**
+     * Splits N points into segments for fitting by windows of about window points, which
+     * include overlap points beyond both ends of their segments. A cut is put into the middle
+     * of the longest run of zero y-values in the last quarter of a segment, if there is no such run
+     * the segment takes all the window except overlaps. Returns starts of segments followed by N
+     */
+    template<typename Float>
+    std::vector<size_t> spline_segments(size_t N, const Float* y, size_t window, size_t overlap)
+    {
+        const size_t core = window - 2*overlap;
+        std::vector<size_t> cuts(1, 0);
+        while(N - cuts.back() > core) cuts.push_back(spline_cut(y, 0, cuts.back(), core));
+        //A short tail joins the previous segment
+        if(cuts.size() > 1 && N - cuts.back() < overlap) cuts.pop_back();
+        cuts.push_back(N);
+        return cuts;
+    }
+
+    /**
+     * Points of a segment [cut, next_cut) of spline_segments of N points: the window [begin, end) fitted
+     * for it, the pieces [own_begin, own_end) taken from the window, and starts of blend zones of overlap
+     * pieces before and after them, which exist unless the segment is the first or the last one
+     */
+    struct spline_window
+    {
+        spline_window(size_t cut, size_t next_cut, size_t N, size_t overlap)
+            :
+              left(cut > 0),
+              right(next_cut < N),
+              begin(cut - std::min(cut, overlap)),
+              end(std::min(N, next_cut + overlap)),
+              left_zone(cut - std::min(cut, overlap / 2)),
+              right_zone(next_cut - overlap / 2),
+              own_begin(left ? left_zone + overlap : 0),
+              own_end(right ? right_zone : N)
+        {}
+
+        bool left, right;
+        size_t begin, end, left_zone, right_zone, own_begin, own_end;
+    };
+
+    /**
+     * Calculates coefficients of a smoothing cubic spline S(x) = a + b*x + c*x^2/2 + d*x^3/6
+     * by windows of about window points fitted independently and concurrently. Neighbouring windows
+     * overlap by 2*overlap points, they are blended by blend_spline_pieces over overlap points around a cut,
+     * so temporary memory is bounded by window size per thread instead of the number of points.
+     * A spline of a window differs from the spline of all points only near its ends, the difference decays
+     * within the overlap of spline_overlap, which is taken for mean step and weight if overlap is zero.
+     * A window is widened to four overlaps, so strong smoothing of moderate data is fitted at once
+     */
+    template<typename Float>
+    void segmented_cubic_spline_coefficients
+    (
+            size_t N, //number of points
+            Float* a,
+            Float* b,
+            Float* c,
+            Float* d,
+            const Float* x,
+            const Float* y,
+            const Float* w,
+            Float smooth,
+            size_t window,
+            size_t overlap
+    )
+    {
+        if(overlap == 0 && N > 1)
+        {
+            const Float wmean = w ? std::accumulate(w, w + N, Float(0)) / N : Float(1);
+            overlap = spline_overlap(smooth, (x[N-1] - x[0]) / (N - 1), wmean);
+        }
+        window = std::max(window, 4 * overlap);
+        if(N <= window || overlap < 2)
+        {
+            cubic_spline_fitter<Float>(N, x, y, w).fit(smooth, a, b, c, d);
+            return;
+        }
+
+        const std::vector<size_t> cuts = spline_segments(N, y, window, overlap);
+        const size_t nseg = cuts.size() - 1;
+        Float* coefs[] = { a, b, c, d };
+
+        //Coefficients of left and right windows in blend zones [cut-half, cut-half+overlap)
+        std::vector<Float> from_left(4 * overlap * (nseg - 1)), from_right(from_left.size());
+
+        //Windows are tasks of the pool, so their systems are factored as single blocks
+        thread_pool::instance().for_each(nseg, [&](size_t k)
+        {
+            std::vector<Float> wc[4];
+            const spline_window win(cuts[k], cuts[k+1], N, overlap);
+            const size_t n = win.end - win.begin;
+            for(std::vector<Float>& v : wc) v.resize(n);
+            cubic_spline_fitter<Float>(n, x + win.begin, y + win.begin, w ? w + win.begin : nullptr)
+                    .fit(smooth, wc[0].data(), wc[1].data(), wc[2].data(), wc[3].data());
+
+            //Indices of the window are relative to its first point
+            for(size_t j = 0; j < 4; ++j)
+            {
+                typename std::vector<Float>::const_iterator src = wc[j].begin();
+                std::copy(src + (win.own_begin - win.begin), src + (win.own_end - win.begin), coefs[j] + win.own_begin);
+                if(win.left)
+                    std::copy(src + (win.left_zone - win.begin), src + (win.left_zone - win.begin + overlap),
+                              from_right.begin() + ((k-1)*4 + j) * overlap);
+                if(win.right)
+                    std::copy(src + (win.right_zone - win.begin), src + (win.right_zone - win.begin + overlap),
+                              from_left.begin() + (k*4 + j) * overlap);
+            }
+        });
+
+        for(size_t k = 0; k + 1 < nseg; ++k)
+        {
+            const size_t zone = spline_window(cuts[k], cuts[k+1], N, overlap).right_zone;
+            const Float* l[4];
+            const Float* r[4];
+            Float* dst[4];
+            for(size_t j = 0; j < 4; ++j)
+            {
+                l[j] = from_left.data() + (k*4 + j) * overlap;
+                r[j] = from_right.data() + (k*4 + j) * overlap;
+                dst[j] = coefs[j] + zone;
+            }
+            blend_spline_pieces(overlap, x + zone, l, r, dst);
+        }
     }
 }
 
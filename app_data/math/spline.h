@@ -1,6 +1,8 @@
 #ifndef SPLINE_H
 #define SPLINE_H
 
+#include <array>
+#include <cmath>
 #include <memory>
 #include <map>
 #include <vector>
@@ -9,25 +11,85 @@
 
 #include "solvers.h"
 #include "array_operations.h"
+#include "piece_max.h"
 
 /**
- * Peacewise polynomial
+ * Peacewise polynomial. Knots are kept in a sorted array and coefficients in a structure of arrays,
+ * one contiguous array per polynomial power
  */
 template<size_t n, typename Float = double>
 class peacewise_poly
 {
 public:
     using poly_coef_type  = std::array<Float, n+1>;
-    using poly_coefs_type = std::map<Float, poly_coef_type>;
+    using knots_type      = std::vector<Float>;
+
+    /**
+     * Reference to coefficients of a single polynomial piece
+     */
+    class coef_ref
+    {
+        peacewise_poly* poly_;
+        size_t idx_;
+    public:
+        coef_ref(peacewise_poly* poly, size_t idx) : poly_(poly), idx_(idx) {}
+
+        Float& operator[](size_t j) { return poly_->coefs_[j][idx_]; }
+
+        coef_ref& operator=(const poly_coef_type& coefs)
+        {
+            for(size_t j = 0; j <= n; ++j) poly_->coefs_[j][idx_] = coefs[j];
+            return *this;
+        }
+    };
 
 private:
-    poly_coefs_type poly_coefs_;
+    knots_type knots_;
+    std::array<std::vector<Float>, n+1> coefs_;
+
+    /**
+     * Index of the first knot which is not less than xval
+     */
+    size_t lower_bound_(Float xval) const
+    {
+        return std::lower_bound(knots_.begin(), knots_.end(), xval) - knots_.begin();
+    }
+
+    /**
+     * Index of a polynomial piece for xval
+     */
+    size_t find_piece_(Float xval) const
+    {
+        size_t idx = lower_bound_(xval);
+        return idx ? idx - 1 : 0;
+    }
+
+    /**
+     * Appends maximums of the pieces [first, last) to ps, every piece idx is checked in
+     * (knots_[idx], knots_[idx+1]] by math::piece_max
+     */
+    void pieces_maxs_(size_t first, size_t last, std::vector<Float>& ps) const
+    {
+        //Pointers are kept in locals, appending to ps does not reload them
+        const Float* a = n >= 3 ? coefs_[n >= 3 ? n - 3 : 0].data() : nullptr;
+        const Float* b = coefs_[n-2].data();
+        const Float* c = coefs_[n-1].data();
+        const Float* k = knots_.data();
+        Float t;
+        for(size_t idx = first; idx < last; ++idx)
+            if(math::piece_max(a ? a[idx] : Float(0), b[idx], c[idx], k[idx+1] - k[idx], t))
+                ps.push_back(k[idx] + t);
+    }
 
 public:
     /**
      * Preallocates poly coefficients in memory
      */
-    peacewise_poly(size_t N = 0){ poly_coefs_.get_allocator().allocate(N); }
+    peacewise_poly(size_t N = 0)
+    {
+        knots_.reserve(N);
+        for(auto& c : coefs_) c.reserve(N);
+    }
     virtual ~peacewise_poly(){}
 
     /**
@@ -36,40 +98,82 @@ public:
     constexpr size_t order() const { return n; }
 
     /**
-     * Sets the polynomial coefficients
+     * Number of polynomial pieces
      */
-    poly_coef_type& operator[](Float xval) { return poly_coefs_[xval]; }
+    size_t size() const { return knots_.size(); }
 
     /**
-     * Estimates y-value that corresponds to a given x-value
+     * Sorted knots, every polynomial piece starts at its knot
      */
-    Float estimate_y_val(const Float& xval) const
+    const knots_type& knots() const { return knots_; }
+
+    /**
+     * Sets the polynomial coefficients, knots are to be added in ascending order to avoid reallocations
+     */
+    coef_ref operator[](Float xval)
+    {
+        size_t idx = knots_.size();
+        if(knots_.empty() || knots_.back() < xval)
+        {
+            knots_.push_back(xval);
+            for(auto& c : coefs_) c.push_back(Float());
+        }
+        else if(knots_[idx = lower_bound_(xval)] != xval)
+        {
+            knots_.insert(knots_.begin() + idx, xval);
+            for(auto& c : coefs_) c.insert(c.begin() + idx, Float());
+        }
+        return coef_ref(this, idx);
+    }
+
+    /**
+     * Estimates y-value using polynomial piece idx
+     */
+    Float estimate_piece(size_t idx, const Float& xval) const
     {
-        auto xyval = poly_coefs_.lower_bound(xval);
-        if(xyval != poly_coefs_.begin()) --xyval;
-        const poly_coef_type& coefs = xyval->second;
-        Float dx = xval - xyval->first;
-        Float res = coefs[0];
+        Float dx = xval - knots_[idx];
+        Float res = coefs_[0][idx];
 
-        math::For<1, n+1, true>::Do([&res, dx, coefs](size_t idx)
+        math::For<1, n+1, true>::Do([&res, dx, idx, this](size_t j)
         {
-            (res *= dx) += coefs[idx];
+            (res *= dx) += coefs_[j][idx];
         });
 
         return res;
     }
 
+    /**
+     * Estimates y-value that corresponds to a given x-value
+     */
+    Float estimate_y_val(const Float& xval) const
+    {
+        return estimate_piece(find_piece_(xval), xval);
+    }
+
     /**
      * Estimates a vector of y values that correspond to a vector of x values
      */
     std::vector<Float> estimate_y_vals(const std::vector<Float>& x) const
     {
         std::vector<Float> y(x.size());
-        std::transform(x.cbegin(), x.cend(),
-                       y.begin(), [this](Float xval)->Float
+        if(knots_.empty()) return y;
+        if(!std::is_sorted(x.cbegin(), x.cend()))
         {
-            return this->estimate_y_val(xval);
-        });
+            std::transform(x.cbegin(), x.cend(),
+                           y.begin(), [this](Float xval)->Float
+            {
+                return this->estimate_y_val(xval);
+            });
+            return y;
+        }
+
+        //Sorted x-values are merged with the knots
+        auto it = knots_.cbegin();
+        for(size_t i = 0; i < x.size(); ++i)
+        {
+            it = math::gallop_lower_bound(it, knots_.cend(), x[i]);
+            y[i] = estimate_piece(it == knots_.cbegin() ? 0 : it - knots_.cbegin() - 1, x[i]);
+        }
         return y;
     }
 
@@ -78,14 +182,14 @@ public:
      */
     peacewise_poly<n-1, Float> diff() const
     {
-        peacewise_poly<n-1, Float> res(this->poly_coefs_.size());
+        peacewise_poly<n-1, Float> res(this->size());
 
-        for(const auto& coef : this->poly_coefs_)
+        for(size_t i = 0; i < this->size(); ++i)
         {
-            auto& diff_coefs = res[coef.first];
-            math::For<0, n, true>::Do([&diff_coefs, coef](size_t j)
+            auto diff_coefs = res[knots_[i]];
+            math::For<0, n, true>::Do([&diff_coefs, i, this](size_t j)
             {
-                diff_coefs[j] = (n - j) * coef.second[j];
+                diff_coefs[j] = (n - j) * coefs_[j][i];
             });
         }
 
@@ -98,18 +202,18 @@ public:
     Float rhzero(const Float& x0) const
     {
         Float y0 = this->estimate_y_val(x0);
-        auto itxy = poly_coefs_.lower_bound(x0);
-        if(itxy == poly_coefs_.end())
+        size_t idx = lower_bound_(x0);
+        if(idx == size())
             return x0;
-        Float y1 = itxy->second[n];
+        Float y1 = coefs_[n][idx];
         while(y0 * y1 >= 0.0)
         {
             y0 = y1;
-            if(++itxy == poly_coefs_.end()) return x0;
-            y1 = itxy->second[n];
+            if(++idx == size()) return x0;
+            y1 = coefs_[n][idx];
         }
-        Float x11 = itxy->first;
-        Float x00 = (--itxy)->first;
+        Float x11 = knots_[idx];
+        Float x00 = knots_[idx ? idx - 1 : 0];
         auto fun = [this](Float x)->Float
         {
             return this->estimate_y_val(x);
@@ -119,36 +223,53 @@ public:
     }
 
     /**
-     * Get all polynomial zeros between begin()->first and end()->first
+     * Get all polynomial zeros between the first and the last knots
      */
     std::vector<Float> get_zeros() const
     {
         std::vector<Float> zs;
-        Float x0 = poly_coefs_.begin()->first;
+        if(knots_.empty()) return zs;
+        Float x0 = knots_.front();
         Float x1 = this->rhzero(x0);
         while(x1 != x0)
         {
             zs.push_back(x1);
-            x0 = poly_coefs_.lower_bound(x1)->first;
+            x0 = knots_[lower_bound_(x1)];
             x1 = this->rhzero(x0);
         }
         return zs;
     }
 
     /**
-     * Get all maximums
+     * Get all maximums between the first and the last knots. Polynomials up to the third order
+     * are solved piece by piece in closed form, large ones are split between threads of thread_pool
      */
     std::vector<Float> get_maxs() const
     {
         if(order() < 2) return std::vector<Float>(); //No maximums for this order
+        if(order() <= 3)
+        {
+            math::thread_pool& pool = math::thread_pool::instance();
+            const size_t npieces = size() ? size() - 1 : 0;
+            const size_t nchunks = pool.chunks(npieces, 1 << 16);
+            std::vector<std::vector<Float>> chunks(nchunks);
+            pool.for_chunks(npieces, nchunks, [this, &chunks](size_t i, size_t first, size_t last)
+            {
+                this->pieces_maxs_(first, last, chunks[i]);
+            });
+
+            std::vector<Float> ps = std::move(chunks[0]);
+            for(size_t i = 1; i < nchunks; ++i) ps.insert(ps.end(), chunks[i].begin(), chunks[i].end());
+            return ps;
+        }
 
         peacewise_poly<n - 1, Float> diff = this->diff();
         std::vector<Float> ps = diff.get_zeros();
 
         auto pred = [this](Float xval)
         {
-            auto it1 = this->poly_coefs_.lower_bound(xval), it2 = it1--;
-            return !(it1->second[n-1] > 0.0 && it2->second[n-1] < 0.0);
+            size_t idx = this->lower_bound_(xval);
+            return !(idx > 0 && idx < this->size() && coefs_[n-1][idx-1] > 0.0 && coefs_[n-1][idx] < 0.0);
         };
 
         typename std::vector<Float>::iterator end =
@@ -194,21 +315,31 @@ class cubic_spline
      */
     void calculate_spline_(const data_vector_type& x, const data_vector_type& y, const data_vector_type& w)
     {
-        size_t N = std::min(x.size(), y.size());
+        calculate_spline_(math::cubic_spline_fitter<Float>(std::min(x.size(), y.size()), x.data(), y.data(), w.data()), 1.0);
+    }
+
+    /**
+     * Calculates spline using prepared fitting
+     */
+    void calculate_spline_(const math::cubic_spline_fitter<Float>& fitter, double smooth_param)
+    {
+        size_t N = fitter.size();
+        const data_vector_type& x = fitter.x();
         std::unique_ptr<Float[]>
                 a(new Float[N]),
                 b(new Float[N]),
                 c(new Float[N]),
                 d(new Float[N]);
-        math::cubic_spline_coefficients(N,a.get(),b.get(),c.get(),d.get(),x.data(),y.data(),w.data());
+        fitter.fit(smooth_param, a.get(), b.get(), c.get(), d.get());
         poly_.reset(new Poly(N));
         auto& refPoly = *poly_;
         for(size_t i = 0; i < N; ++i)
         {
-            refPoly[x[i]][0] = d[i]/6.;
-            refPoly[x[i]][1] = c[i]/2.;
-            refPoly[x[i]][2] = b[i];
-            refPoly[x[i]][3] = a[i];
+            auto coefs = refPoly[x[i]];
+            coefs[0] = d[i]/6.;
+            coefs[1] = c[i]/2.;
+            coefs[2] = b[i];
+            coefs[3] = a[i];
         }
     }
 
@@ -237,6 +368,15 @@ public:
         calculate_spline_(x,y,w_);
     }
 
+    /**
+     * Creates cubic spline from a prepared fitting of data, only the smoothing parameter
+     * dependent part of the spline equations is solved
+     */
+    cubic_spline(const math::cubic_spline_fitter<Float>& fitter, double smooth_param)
+    {
+        calculate_spline_(fitter, smooth_param);
+    }
+
     virtual ~cubic_spline(){}
 
     /**
@@ -0,0 +1,153 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace math {
+    /**
+     * Process wide pool of threads running indexed tasks of parallel loops. Threads are started once
+     * and reused by all loops, a calling thread takes tasks of its loop as well. A loop started from a task
+     * of another loop runs sequentially, so nested loops do not oversubscribe cores
+     */
+    class thread_pool
+    {
+    public:
+        using size_t = std::size_t;
+
+        static thread_pool& instance()
+        {
+            static thread_pool pool;
+            return pool;
+        }
+
+        /**
+         * Number of threads a loop started by the calling thread runs on, it is one inside a loop
+         */
+        size_t concurrency() const { return in_loop_() ? 1 : threads_.size() + 1; }
+
+        /**
+         * Number of chunks of at least min_chunk items [0, n) is split into for a loop, at least one
+         */
+        size_t chunks(size_t n, size_t min_chunk) const
+        {
+            return std::min(concurrency(), std::max<size_t>(1, n / min_chunk));
+        }
+
+        /**
+         * Calls fun(i, first, last) for every chunk [first, last) of [0, n) concurrently,
+         * chunks are numbered in ascending order of items
+         */
+        template<class Fun>
+        void for_chunks(size_t n, size_t nchunks, Fun fun)
+        {
+            for_each(nchunks, [n, nchunks, &fun](size_t i) { fun(i, n * i / nchunks, n * (i + 1) / nchunks); });
+        }
+
+        /**
+         * Calls fun(i) for i in [0, n) concurrently and returns when all calls are finished
+         */
+        template<class Fun>
+        void for_each(size_t n, Fun fun)
+        {
+            if(n <= 1 || concurrency() == 1)
+            {
+                for(size_t i = 0; i < n; ++i) fun(i);
+                return;
+            }
+
+            std::shared_ptr<loop> l = std::make_shared<loop>(n, std::function<void(size_t)>(fun));
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for(size_t i = 1; i < std::min(n, concurrency()); ++i) tasks_.push_back(l);
+            }
+            wake_.notify_all();
+
+            in_loop_() = true;
+            l->run();
+            in_loop_() = false;
+
+            std::unique_lock<std::mutex> lock(l->mutex);
+            l->done_cv.wait(lock, [&l] { return l->done == l->n; });
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for(std::thread& t : threads_) t.join();
+        }
+
+    private:
+        //Tasks of a loop are taken by index, late helpers find no tasks and leave
+        struct loop
+        {
+            loop(size_t count, std::function<void(size_t)> f) : n(count), fun(std::move(f)), next(0), done(0) {}
+
+            const size_t n;
+            const std::function<void(size_t)> fun;
+            std::atomic<size_t> next;
+            size_t done;                    //guarded by mutex
+            std::mutex mutex;
+            std::condition_variable done_cv;
+
+            void run()
+            {
+                size_t count = 0;
+                for(size_t i = next++; i < n; i = next++, ++count) fun(i);
+                if(count == 0) return;
+                std::lock_guard<std::mutex> lock(mutex);
+                done += count;
+                if(done == n) done_cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads_;
+        std::deque<std::shared_ptr<loop>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stop_;
+
+        thread_pool() : stop_(false)
+        {
+            const size_t n = std::max(1u, std::thread::hardware_concurrency());
+            for(size_t i = 1; i < n; ++i) threads_.emplace_back([this] { work_(); });
+        }
+
+        static bool& in_loop_()
+        {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        void work_()
+        {
+            in_loop_() = true;
+            for(;;)
+            {
+                std::shared_ptr<loop> l;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                    if(tasks_.empty()) return;
+                    l = tasks_.front();
+                    tasks_.pop_front();
+                }
+                l->run();
+            }
+        }
+    };
+}
+
+#endif // THREAD_POOL_H
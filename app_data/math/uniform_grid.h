@@ -0,0 +1,37 @@
+#ifndef UNIFORM_GRID_H
+#define UNIFORM_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace math {
+    /**
+     * Maximal deviation of values from a uniform grid in units in the last place of the largest value
+     * of the grid. Values within it are reproduced by the grid up to rounding, so a grid loses no data
+     */
+    const double uniform_grid_ulps = 4.0;
+
+    /**
+     * Detects if n values lie on a uniform grid start + step * index within uniform_grid_ulps.
+     * The grid passes through the first and the last values, step is positive
+     */
+    template<typename Float>
+    bool uniform_grid(const Float* values, std::size_t n, Float& start, Float& step)
+    {
+        if(n < 2) return false;
+        start = values[0];
+        step = (values[n-1] - values[0]) / Float(n - 1);
+        if(!(step > Float(0))) return false;
+
+        //Compares with an ideal grid, so rounding errors are not accumulated
+        const Float tolerance = Float(uniform_grid_ulps) * std::numeric_limits<Float>::epsilon()
+                * std::max(std::fabs(values[0]), std::fabs(values[n-1]));
+        for(std::size_t i = 0; i < n; ++i)
+            if(std::fabs(values[i] - (start + step * Float(i))) > tolerance) return false;
+        return true;
+    }
+}
+
+#endif // UNIFORM_GRID_H
@@ -0,0 +1,101 @@
+#include "minmax_pyramid.h"
+#include "data_column.h"
+
+#include <algorithm>
+#include <iterator>
+
+minmax_pyramid::minmax_pyramid(const data_column& x, const data_column& y)
+    :
+      size_(std::min(x.size(), y.size())),
+      min_(0.0),
+      max_(0.0),
+      min_index_(0),
+      max_index_(0)
+{
+    if(size_ == 0) return;
+
+    //The first level is built from points in a single pass, so compact columns stay compact
+    level first;
+    first.bucket = first_bucket;
+    const size_t nbuckets = (size_ + first_bucket - 1) / first_bucket;
+    first.mins.resize(nbuckets);
+    first.maxs.resize(nbuckets);
+    first.min_first.resize(nbuckets);
+    data_column::const_iterator it = y.begin();
+    min_ = max_ = *it;
+    for(size_t b = 0, i = 0; b < nbuckets; ++b)
+    {
+        const size_t end = std::min(size_, i + first_bucket);
+        double lo = *it, hi = lo;
+        size_t ilo = i, ihi = i;
+        for(; i < end; ++i, ++it)
+        {
+            double val = *it;
+            if(val < lo) { lo = val; ilo = i; }
+            if(val > hi) { hi = val; ihi = i; }
+        }
+        first.mins[b] = lo;
+        first.maxs[b] = hi;
+        first.min_first[b] = ilo <= ihi;
+        if(lo < min_) { min_ = lo; min_index_ = ilo; }
+        if(hi > max_) { max_ = hi; max_index_ = ihi; }
+    }
+    levels_.push_back(std::move(first));
+
+    while(levels_.back().mins.size() > 1)
+    {
+        const level& prev = levels_.back();
+        level next;
+        next.bucket = prev.bucket * factor;
+        const size_t n = (prev.mins.size() + factor - 1) / factor;
+        next.mins.resize(n);
+        next.maxs.resize(n);
+        next.min_first.resize(n);
+        for(size_t b = 0; b < n; ++b)
+        {
+            const size_t end = std::min(prev.mins.size(), (b + 1) * factor);
+            size_t clo = b * factor, chi = clo;
+            for(size_t c = clo + 1; c < end; ++c)
+            {
+                if(prev.mins[c] < prev.mins[clo]) clo = c;
+                if(prev.maxs[c] > prev.maxs[chi]) chi = c;
+            }
+            next.mins[b] = prev.mins[clo];
+            next.maxs[b] = prev.maxs[chi];
+            next.min_first[b] = clo < chi || (clo == chi && prev.min_first[clo]);
+        }
+        levels_.push_back(std::move(next));
+    }
+}
+
+void minmax_pyramid::decimate(const data_column& x, const data_column& y, size_t begin, size_t end, size_t n,
+                              std::vector<double>& xs, std::vector<double>& ys) const
+{
+    end = std::min(end, size_);
+    if(begin >= end) return;
+    const size_t count = end - begin;
+
+    const level* lev = nullptr;
+    for(const level& l : levels_) if(l.bucket * n <= count) lev = &l;
+
+    if(!lev)
+    {
+        std::copy(x.begin() + begin, x.begin() + end, std::back_inserter(xs));
+        std::copy(y.begin() + begin, y.begin() + end, std::back_inserter(ys));
+        return;
+    }
+
+    //Buckets partly out of the range are taken whole, so lines continue beyond a view
+    const size_t first = begin / lev->bucket, last = (end - 1) / lev->bucket + 1;
+    xs.reserve(xs.size() + 2 * (last - first));
+    ys.reserve(ys.size() + 2 * (last - first));
+    for(size_t b = first; b < last; ++b)
+    {
+        const size_t i = b * lev->bucket, j = std::min(size_, i + lev->bucket) - 1;
+        const bool min_first = lev->min_first[b];
+        xs.push_back(x[i]);
+        ys.push_back(min_first ? lev->mins[b] : lev->maxs[b]);
+        xs.push_back(x[j]);
+        ys.push_back(min_first ? lev->maxs[b] : lev->mins[b]);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef MINMAX_PYRAMID_H
+#define MINMAX_PYRAMID_H
+
+#include <cstddef>
+#include <vector>
+
+class data_column;
+
+/**
+ * Levels of minimal and maximal y-values of buckets of sequential points for plotting.
+ * Buckets of the first level hold first_bucket points, every next level joins factor buckets.
+ * A plot of any x-range takes about two points per pixel from a level whose buckets are not
+ * wider than a pixel, so the shape of spikes is kept while the number of points drawn is bounded
+ */
+class minmax_pyramid
+{
+public:
+    using size_t = std::size_t;
+
+    static const size_t first_bucket = 16;
+    static const size_t factor = 4;
+
+    minmax_pyramid() : size_(0) {}
+
+    /**
+     * Builds levels for y-values of sorted x-values
+     */
+    minmax_pyramid(const data_column& x, const data_column& y);
+
+    /**
+     * Number of points
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * Global minimum and maximum with their indices
+     */
+    double min() const { return min_; }
+    double max() const { return max_; }
+    size_t min_index() const { return min_index_; }
+    size_t max_index() const { return max_index_; }
+
+    /**
+     * Appends to xs and ys points outlining the points [begin, end) of x and y columns the pyramid is built for
+     * on a plot n pixels wide: extreme values of buckets of the coarsest level whose buckets are not wider
+     * than a pixel in order of their appearance, or the points themselves if there is no such level
+     */
+    void decimate(const data_column& x, const data_column& y, size_t begin, size_t end, size_t n,
+                  std::vector<double>& xs, std::vector<double>& ys) const;
+
+private:
+    struct level
+    {
+        size_t bucket;                  //points in a bucket
+        std::vector<double> mins, maxs;
+        std::vector<bool> min_first;    //a minimum goes before a maximum in a bucket
+    };
+
+    size_t size_;
+    double min_, max_;
+    size_t min_index_, max_index_;
+    std::vector<level> levels_;
+};
+
+#endif // MINMAX_PYRAMID_H
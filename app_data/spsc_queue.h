@@ -0,0 +1,80 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread
+ */
+template<typename T>
+class spsc_queue
+{
+    std::vector<T> items_;
+    const std::size_t mask_;
+
+    //Producer and consumer positions live on separate cache lines
+    std::atomic<std::size_t> head_;
+    char padding_[64];
+    std::atomic<std::size_t> tail_;
+
+    static std::size_t round_capacity(std::size_t n)
+    {
+        std::size_t res = 2;
+        while(res < n) res <<= 1;
+        return res;
+    }
+
+public:
+    /**
+     * Capacity is rounded up to a power of two
+     */
+    explicit spsc_queue(std::size_t capacity = 64)
+        :
+          items_(round_capacity(capacity)),
+          mask_(items_.size() - 1),
+          head_(0),
+          tail_(0)
+    {}
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    /**
+     * Producer side, returns false if the queue is full
+     */
+    bool try_push(T&& item)
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_.load(std::memory_order_acquire) == items_.size()) return false;
+        items_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side, returns false if the queue is empty
+     */
+    bool try_pop(T& item)
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_.load(std::memory_order_acquire)) return false;
+        item = std::move(items_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Approximate number of items, exact if called from the producer or the consumer with the other one idle
+     */
+    std::size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,342 @@
+#include "text_parser.h"
+#include "math/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    /**
+     * Exactly representable powers of ten
+     */
+    const double exact_pow10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /**
+     * Returns the end of a block which starts at begin and has about size bytes
+     */
+    inline const char* block_end(const char* begin, const char* end, std::size_t size)
+    {
+        if(std::size_t(end - begin) <= size) return end;
+        const char* nl = static_cast<const char*>(std::memchr(begin + size, '\n', end - begin - size));
+        return nl ? nl + 1 : end;
+    }
+
+    /**
+     * Combines an error of a block parsed separately with the rule that two column rows are not allowed
+     * after three column ones in the preceding blocks. Returns false if the block is not to be kept
+     */
+    bool block_error
+    (
+        text_parser::parse_error& err,
+        const text_parser::parse_error& block_err,
+        const text_parser::columns& block,
+        bool has_weights,
+        std::size_t line_offset
+    )
+    {
+        using text_parser::parse_error;
+        if(block_err) err = parse_error(block_err.type, block_err.line + line_offset, block_err.columns);
+        if(has_weights && block.first_pair_line && (!err || block.first_pair_line + line_offset < err.line))
+        {
+            //Such a line is the first data line of the block, so nothing is parsed before it
+            err = parse_error(parse_error::COLUMNS_NUMBER, block.first_pair_line + line_offset, 2);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Correctly rounded conversion for values which are out of the fast path
+     */
+    bool slow_parse_double(const char* begin, const char* end, double& val)
+    {
+        std::istringstream stream(std::string(begin, end));
+        stream.imbue(std::locale::classic());
+        stream >> val;
+        return !stream.fail();
+    }
+}
+
+bool text_parser::parse_double(const char* begin, const char* end, double& val)
+{
+    val = 0.0;
+    while(begin != end && is_blank(*begin)) ++begin;
+    while(begin != end && is_blank(*(end-1))) --end;
+
+    const char* p = begin;
+    bool negative = false;
+    if(p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    std::uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool has_digits = false;
+
+    for(; p != end && is_digit(*p); ++p, has_digits = true)
+    {
+        if(digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if(mantissa) ++digits; }
+        else ++exponent;
+    }
+    if(p != end && *p == '.')
+    {
+        for(++p; p != end && is_digit(*p); ++p, has_digits = true)
+        {
+            if(digits < 19) { mantissa = mantissa * 10 + (*p - '0'); --exponent; if(mantissa) ++digits; }
+        }
+    }
+    if(!has_digits) return false;
+
+    if(p != end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negative_exp = false;
+        if(p != end && (*p == '-' || *p == '+')) negative_exp = (*p++ == '-');
+        if(p == end || !is_digit(*p)) return false;
+        int e = 0;
+        for(; p != end && is_digit(*p); ++p) if(e < 100000) e = e * 10 + (*p - '0');
+        exponent += negative_exp ? -e : e;
+    }
+    if(p != end) return false;
+
+    //Mantissa and power of ten are both exact, so the result is correctly rounded
+    if(mantissa < (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double res = static_cast<double>(mantissa);
+        res = exponent < 0 ? res / exact_pow10[-exponent] : res * exact_pow10[exponent];
+        val = negative ? -res : res;
+        return true;
+    }
+
+    if(!slow_parse_double(begin, end, val)) { val = 0.0; return false; }
+    return true;
+}
+
+text_parser::parse_error text_parser::parse_columns
+(
+    const char* begin,
+    const char* end,
+    const text_format& format,
+    columns& cols,
+    std::size_t first_text_line,
+    const progress_callback& progress
+)
+{
+    const std::size_t progress_lines = 1 << 16;
+    const char* fields[3];
+    std::size_t line_number = 0;
+
+    for(const char* line = begin; line != end; )
+    {
+        const char* line_end = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        const char* next = line_end ? line_end + 1 : end;
+        if(!line_end) line_end = end;
+        line_number++;
+
+        if(line == line_end || !(is_digit(*line) || (*line && std::strchr(format.leading_chars, *line))))
+        {
+            cols.lines = line_number;
+            if(line_number != first_text_line)
+                return parse_error(parse_error::TEXT_LINE, line_number);
+            line = next;
+            continue;
+        }
+
+        //Splits the line by delimiter, only three first field positions are stored
+        std::size_t ncols = 1;
+        fields[0] = line;
+        for(const char* p = line; p != line_end; ++p)
+        {
+            if(*p == format.delimiter)
+            {
+                if(ncols < 3) fields[ncols] = p + 1;
+                ncols++;
+            }
+        }
+
+        if(!((ncols == 2 && cols.w.empty()) || ncols == 3))
+        {
+            cols.lines = line_number;
+            return parse_error(parse_error::COLUMNS_NUMBER, line_number, ncols);
+        }
+        if(ncols == 2 && !cols.first_pair_line) cols.first_pair_line = line_number;
+
+        double val;
+        parse_double(fields[0], fields[1] - 1, val); cols.x.push_back(val);
+        parse_double(fields[1], ncols == 3 ? fields[2] - 1 : line_end, val); cols.y.push_back(val);
+        if(ncols == 3) { parse_double(fields[2], line_end, val); cols.w.push_back(val); }
+
+        if(progress && line_number % progress_lines == 0) progress(next - begin);
+        line = next;
+    }
+
+    cols.lines = line_number;
+    if(progress) progress(end - begin);
+    return parse_error();
+}
+
+text_parser::parse_error text_parser::parse_columns_parallel
+(
+    const char* begin,
+    const char* end,
+    const text_format& format,
+    columns& cols,
+    std::size_t nthreads,
+    const progress_callback& progress
+)
+{
+    //Small files are not worth starting threads
+    const std::size_t min_chunk_size = 1 << 20;
+    const std::size_t size = end - begin;
+
+    //Chunks are tasks of the process wide pool, so loads running at once share its threads
+    math::thread_pool& pool = math::thread_pool::instance();
+    if(nthreads == 0) nthreads = pool.concurrency();
+    std::size_t nchunks = std::min(nthreads, std::max<std::size_t>(1, size / min_chunk_size));
+    if(nchunks == 1)
+    {
+        cols.x.reserve(estimate_lines(begin, end));
+        cols.y.reserve(cols.x.capacity());
+        return parse_columns(begin, end, format, cols, 1, progress);
+    }
+
+    //Chunk boundaries are moved to the beginning of the next line
+    std::vector<const char*> bounds(nchunks + 1, end);
+    bounds[0] = begin;
+    for(std::size_t i = 1; i < nchunks; ++i)
+        bounds[i] = block_end(bounds[i-1], end,
+                              std::max<std::ptrdiff_t>(0, begin + i * (size / nchunks) - bounds[i-1]));
+
+    std::vector<columns> chunks(nchunks);
+    std::vector<parse_error> errors(nchunks);
+    std::atomic<std::size_t> parsed_bytes(0);
+    const std::thread::id caller = std::this_thread::get_id();
+
+    //The calling thread takes chunks as well, progress of all chunks is reported while it parses
+    pool.for_each(nchunks, [&](std::size_t i)
+    {
+        std::size_t reported = 0;
+        columns& chunk = chunks[i];
+        chunk.x.reserve(estimate_lines(bounds[i], bounds[i+1]));
+        chunk.y.reserve(chunk.x.capacity());
+        //Only the first line of the first chunk may contain text information
+        errors[i] = parse_columns(bounds[i], bounds[i+1], format, chunk, i == 0 ? 1 : 0,
+            [&parsed_bytes, &reported, &progress, caller](std::size_t nbytes)
+        {
+            parsed_bytes += nbytes - reported;
+            reported = nbytes;
+            if(progress && std::this_thread::get_id() == caller) progress(parsed_bytes);
+        });
+    });
+
+    //Stitching: the first error in file order wins, two column rows are not allowed after three column ones
+    parse_error err;
+    std::size_t line_offset = 0, npoints = 0, nweights = 0;
+    bool has_weights = false;
+    for(std::size_t i = 0; i < nchunks && !err; ++i)
+    {
+        const columns& chunk = chunks[i];
+        bool keep_chunk = block_error(err, errors[i], chunk, has_weights, line_offset);
+        if(err)
+        {
+            //Keep rows parsed before the error like the sequential parser does
+            nchunks = i + (keep_chunk ? 1 : 0);
+            break;
+        }
+        has_weights = has_weights || !chunk.w.empty();
+        line_offset += chunk.lines;
+    }
+
+    for(std::size_t i = 0; i < nchunks; ++i)
+    {
+        npoints += chunks[i].x.size();
+        nweights += chunks[i].w.size();
+    }
+
+    //Chunks are copied into the resulting columns concurrently
+    std::vector<std::size_t> offsets(nchunks), offsets_w(nchunks);
+    for(std::size_t i = 1; i < nchunks; ++i)
+    {
+        offsets[i] = offsets[i-1] + chunks[i-1].x.size();
+        offsets_w[i] = offsets_w[i-1] + chunks[i-1].w.size();
+    }
+    cols = std::move(chunks[0]);
+    cols.x.resize(npoints);
+    cols.y.resize(npoints);
+    cols.w.resize(nweights);
+    if(nchunks > 1)
+    {
+        pool.for_each(nchunks - 1, [&cols, &chunks, &offsets, &offsets_w](std::size_t k)
+        {
+            const columns& chunk = chunks[k+1];
+            std::copy(chunk.x.begin(), chunk.x.end(), cols.x.begin() + offsets[k+1]);
+            std::copy(chunk.y.begin(), chunk.y.end(), cols.y.begin() + offsets[k+1]);
+            std::copy(chunk.w.begin(), chunk.w.end(), cols.w.begin() + offsets_w[k+1]);
+        });
+    }
+    cols.lines = line_offset;
+
+    if(!err && progress) progress(size);
+    return err;
+}
+
+text_parser::parse_error text_parser::parse_columns_blocks
+(
+    const char* begin,
+    const char* end,
+    const text_format& format,
+    columns& cols,
+    std::size_t block_size,
+    const block_callback& callback
+)
+{
+    parse_error err;
+    std::size_t line_offset = 0;
+    bool has_weights = false;
+    columns block;
+    cols.x.reserve(estimate_lines(begin, end));
+    cols.y.reserve(cols.x.capacity());
+
+    for(const char* p = begin; p != end && !err; )
+    {
+        const char* next = block_end(p, end, block_size);
+        block.x.clear(); block.y.clear(); block.w.clear();
+        block.first_pair_line = 0;
+        parse_error block_err = parse_columns(p, next, format, block, p == begin ? 1 : 0);
+        if(!block_error(err, block_err, block, has_weights, line_offset)) break;
+
+        const bool go_on = callback(block, next - begin);
+        cols.x.insert(cols.x.end(), block.x.begin(), block.x.end());
+        cols.y.insert(cols.y.end(), block.y.begin(), block.y.end());
+        cols.w.insert(cols.w.end(), block.w.begin(), block.w.end());
+        has_weights = has_weights || !block.w.empty();
+        line_offset += block.lines;
+        p = next;
+        if(!go_on) break;
+    }
+
+    cols.lines = line_offset;
+    return err;
+}
+
+std::size_t text_parser::estimate_lines(const char* begin, const char* end)
+{
+    const std::size_t sample_size = 1 << 16;
+    std::size_t size = end - begin, sample = std::min(size, sample_size), lines = 0;
+    for(const char* p = begin; p != begin + sample; ++p) if(*p == '\n') lines++;
+    if(sample == size) return lines + 1;
+    //10% margin for a tail with longer numbers
+    return lines ? std::size_t(double(lines) / sample * size * 1.1) : 0;
+}
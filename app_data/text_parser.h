@@ -0,0 +1,123 @@
+#ifndef TEXT_PARSER_H
+#define TEXT_PARSER_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace text_parser
+{
+    /**
+     * Describes delimited text: a column delimiter and chars, except digits, a data line may start with
+     */
+    struct text_format
+    {
+        char delimiter;
+        const char* leading_chars;
+    };
+
+    const text_format tab_separated   = { '\t', "+." };
+    const text_format comma_separated = { ',', "+.," };
+
+    /**
+     * Columns parsed from a block of text
+     */
+    struct columns
+    {
+        std::vector<double> x, y, w;
+        std::size_t lines = 0;              ///number of parsed lines
+        std::size_t first_pair_line = 0;    ///first line with two columns, zero if there is no such line
+    };
+
+    /**
+     * Result of a parsing, line numbers are counted from the first line of a parsed block
+     */
+    struct parse_error
+    {
+        enum error_type
+        {
+            PARSE_OK = 0x00,        ///text is parsed
+            TEXT_LINE = 0x01,       ///text information is found not on the first line
+            COLUMNS_NUMBER = 0x02   ///wrong number of columns
+        };
+
+        error_type type;
+        std::size_t line;
+        std::size_t columns;
+
+        parse_error(error_type t = PARSE_OK, std::size_t l = 0, std::size_t c = 0)
+            : type(t), line(l), columns(c) {}
+
+        operator bool() const { return type != PARSE_OK; }
+    };
+
+    /**
+     * Is called with a number of parsed bytes from time to time
+     */
+    using progress_callback = std::function<void(std::size_t)>;
+
+    /**
+     * Converts text [begin, end) into a double value, surrounding blanks are skipped.
+     * Returns false and sets val to zero if the text is not a number
+     */
+    bool parse_double(const char* begin, const char* end, double& val);
+
+    /**
+     * Parses delimited text [begin, end) directly from memory into the columns.
+     * A text line is allowed only on the line with the number first_text_line,
+     * lines with two columns are allowed only before the first line with three columns.
+     */
+    parse_error parse_columns
+    (
+        const char* begin,
+        const char* end,
+        const text_format& format,
+        columns& cols,
+        std::size_t first_text_line = 1,
+        const progress_callback& progress = progress_callback()
+    );
+
+    /**
+     * Splits [begin, end) into newline aligned chunks and parses them concurrently by up to nthreads
+     * threads of math::thread_pool (all of them if zero). Parsed chunks are joined in the original row order,
+     * the line number of an error is counted from the beginning of the text.
+     * The progress callback is always invoked from the calling thread.
+     */
+    parse_error parse_columns_parallel
+    (
+        const char* begin,
+        const char* end,
+        const text_format& format,
+        columns& cols,
+        std::size_t nthreads = 0,
+        const progress_callback& progress = progress_callback()
+    );
+
+    /**
+     * Is called with every block parsed by parse_columns_blocks and the number of parsed bytes,
+     * returns false to stop parsing
+     */
+    using block_callback = std::function<bool(const columns&, std::size_t)>;
+
+    /**
+     * Parses [begin, end) sequentially by newline aligned blocks of about block_size bytes,
+     * every block is passed to the callback right after parsing and then appended to the columns.
+     * Columns stay partial if the callback stops parsing
+     */
+    parse_error parse_columns_blocks
+    (
+        const char* begin,
+        const char* end,
+        const text_format& format,
+        columns& cols,
+        std::size_t block_size,
+        const block_callback& callback
+    );
+
+    /**
+     * Quickly estimates number of lines in [begin, end) using a leading sample of the text
+     */
+    std::size_t estimate_lines(const char* begin, const char* end);
+}
+
+#endif // TEXT_PARSER_H
@@ -2,6 +2,9 @@
 #include "../app_data/data_export.h"
 #include "../app_data/app_data.h"
 #include "../app_data_handler/approximator_factory.h"
+#include "../app_data/binary_format.h"
+#include "../app_data/minmax_pyramid.h"
+#include "../app_data_handler/peak_pipeline.h"
 
 #include <QFile>
 #include <QTextStream>
@@ -9,54 +12,218 @@
 
 app_data_handler::app_data_handler(QObject *parent)
     :
-      QThread(parent)
+      QObject(parent),
+      scheduler_(new job_scheduler),
+      streaming_(false),
+      pipeline_(false),
+      pipeline_smooth_(1.0),
+      first_block_(true)
 {
+    //Loads read files while others are parsed, fits and exports use all cores or a disk by themselves
+    scheduler_->set_limit(job_scheduler::LOAD_JOB, 2);
+    scheduler_->set_limit(job_scheduler::FIT_JOB, 1);
+    scheduler_->set_limit(job_scheduler::EXPORT_JOB, 1);
     connect(this, SIGNAL(started()), this, SIGNAL(busy()));
     connect(this, SIGNAL(finished()), this, SIGNAL(free()));
-    connect(this, SIGNAL(finished()), this, SLOT(get_data()));
+    connect(this, SIGNAL(loaded(quint64)), this, SLOT(get_data(quint64)), Qt::QueuedConnection);
+    connect(this, SIGNAL(load_failed(quint64)), this, SLOT(drop_data(quint64)), Qt::QueuedConnection);
+
+    //Exceptions of jobs are reported as warnings, a failed load is finished by drop_data
+    scheduler_->set_failure_handler
+    (
+        [this](job_scheduler::job_id job, job_scheduler::job_type type, const std::string& what)
+        {
+            Q_EMIT this->warning(QString("Processing failed: %1").arg(QString::fromLocal8Bit(what.c_str())));
+            if(type == job_scheduler::LOAD_JOB) Q_EMIT this->load_failed(quint64(job));
+        }
+    );
 }
 
 app_data_handler::~app_data_handler()
 {
-
+    //Jobs are finished before data they refer to are released, a streaming load waiting for get_blocks is aborted
+    if(loading_) loading_->exporter->abort();
+    pipeline_of_loading_.reset();
+    scheduler_.reset();
 }
 
 void app_data_handler::load_data(QString file_name)
 {
     QStringList splitList = file_name.split(".");
     QString ext = *std::prev(splitList.end());
+    data_exporter* pExporter = Q_NULLPTR;
     if(ext == "txt" || ext == "dat")
     {
-        this->data_exporter_.reset(
-                    data_export_factory::create_data_exporter(ASCII_FILE, QVariant(file_name)));
+        pExporter = data_export_factory::create_data_exporter(CACHED_ASCII_FILE, QVariant(file_name));
     }
     if(ext == "csv")
     {
-        this->data_exporter_.reset(
-                    data_export_factory::create_data_exporter(CSV_FILE, QVariant(file_name)));
+        pExporter = data_export_factory::create_data_exporter(CACHED_CSV_FILE, QVariant(file_name));
+    }
+    if(ext == "mps")
+    {
+        pExporter = data_export_factory::create_data_exporter(BINARY_FILE, QVariant(file_name));
+    }
+    if(!pExporter) return;
+
+    //The last reference may be dropped by a job, the exporter is deleted in the thread of its connections
+    QSharedPointer<data_exporter> exporter(pExporter, &QObject::deleteLater);
+    exporter->set_streaming(streaming_ || pipeline_);
+
+    //The exporter is connected before its job is submitted, so no block or error is lost
+    connect(exporter.data(), SIGNAL(block_ready()), this, SLOT(get_blocks()));
+    connect(exporter.data(), SIGNAL(error(QString)), this, SIGNAL(warning(QString)));
+
+    if(loading_)
+    {
+        scheduler_->cancel(loading_->job);
+        loading_->exporter->abort();
+    }
+    QSharedPointer<loading> load(new loading);
+    load->exporter = exporter;
+    loading_ = load;
+    first_block_ = true;
+
+    Q_EMIT this->started();
+    load->job = scheduler_->submit
+    (
+        job_scheduler::LOAD_JOB,
+        [this, load](job_scheduler::context& ctx)
+        {
+            //Progress of the exporter is reported as progress of the job
+            QMetaObject::Connection progress =
+                    QObject::connect(load->exporter.data(), &data_exporter::progress_val,
+                                     [&ctx](int val) { ctx.progress(val); });
+            load->exporter->run();
+            QObject::disconnect(progress);
 
+            //Const access keeps mapped columns as views
+            QSharedPointer<const xy_data> data = load->exporter->data_ptr();
+            if(data && !ctx.cancelled()) load->pyramid.reset(new minmax_pyramid(data->x(), data->y()));
+            Q_EMIT this->loaded(quint64(ctx.id()));
+        },
+        std::vector<job_scheduler::job_id>(),
+        [this](int val) { Q_EMIT this->progress_val(val); }
+    );
+
+    //Overlaps of the segmented spline follow the smoothing, so peaks are the ones of the spline of all points
+    pipeline_of_loading_.reset();
+    if(pipeline_)
+    {
+        const quint64 job = load->job;
+        pipeline_of_loading_.reset(new peak_pipeline
+        (
+            *scheduler_, pipeline_smooth_, CubicSplineApproximator::nSegmentWindow, 0,
+            [this, job](const std::vector<double>& positions, const std::vector<double>& intensities)
+            {
+                Q_EMIT this->peaks_found(job, QVector<double>::fromStdVector(positions),
+                                         QVector<double>::fromStdVector(intensities));
+            }
+        ));
     }
-    this->start();
-    connect(this->data_exporter_.data(), SIGNAL(progress_val(int)),
-        this, SIGNAL(progress_val(int)));
-    connect(this->data_exporter_.data(), SIGNAL(error(QString)),
-        this, SIGNAL(warning(QString)));
 }
 
-void app_data_handler::run()
+void app_data_handler::save_data(QString file_name)
 {
-    if(this->data_exporter_)
-        this->data_exporter_->run();
+    if(!xy_data_) return;
+    QSharedPointer<const xy_data> data = xy_data_;
+    if(!data->w().empty() && data->w().size() != data->x().size())
+    {
+        Q_EMIT this->warning("Weights are not given for all points, data can not be saved.");
+        return;
+    }
+    scheduler_->submit
+    (
+        job_scheduler::EXPORT_JOB,
+        [this, data, file_name](job_scheduler::context&)
+        {
+            //Compact columns are copied here, dense caches of the data may be used by other jobs
+            data_vector_type vx, vy, vw;
+            auto values = [](const data_column& column, data_vector_type& copy) -> const double*
+            {
+                if(column.type() == data_column::DENSE || column.is_view()) return column.data();
+                copy.assign(column.begin(), column.end());
+                return copy.data();
+            };
+            const double* x = values(data->x(), vx);
+            const double* y = values(data->y(), vy);
+            const double* w = data->w().empty() ? Q_NULLPTR : values(data->w(), vw);
+            std::string error;
+            //Non-ASCII paths are encoded like the paths of text caches
+            const std::string name = QFile::encodeName(file_name).toStdString();
+            if(!binary_format::write_file(name, x, y, w, data->x().size(), error))
+                Q_EMIT this->warning(QString::fromStdString(error));
+        }
+    );
 }
 
-void app_data_handler::get_data()
+void app_data_handler::get_blocks()
 {
-    if(this->data_exporter_->data_ptr())
+    //Blocks of a superseded load are dropped, so its exporter does not wait for a consumer
+    data_exporter* exporter = qobject_cast<data_exporter*>(this->sender());
+    bool current = loading_ && loading_->exporter.data() == exporter;
+    vector_data_type x, y;
+    data_block block;
+    while(exporter && exporter->pop_block(block))
     {
-        xy_data_ = this->data_exporter_->data_ptr();
-        Q_EMIT this->data_changed(
-                    vector_data_type::fromStdVector(xy_data_.data()->x()),
-                    vector_data_type::fromStdVector(xy_data_.data()->y()));
+        if(!current) continue;
+        if(pipeline_of_loading_) pipeline_of_loading_->push(block.x.data(), block.y.data(), block.x.size());
+        if(!streaming_) continue;
+        int n = x.size();
+        x.resize(n + int(block.x.size()));
+        y.resize(n + int(block.y.size()));
+        std::copy(block.x.begin(), block.x.end(), x.begin() + n);
+        std::copy(block.y.begin(), block.y.end(), y.begin() + n);
+    }
+    if(x.isEmpty()) return;
+
+    //The first block replaces data of a previous file
+    if(first_block_) Q_EMIT this->data_changed(x, y);
+    else Q_EMIT this->data_appended(x, y);
+    first_block_ = false;
+}
+
+void app_data_handler::get_data(quint64 job)
+{
+    if(!loading_ || loading_->job != job) return;
+    QSharedPointer<loading> load = loading_;
+    loading_.reset();
+
+    //Whole data replaces streamed blocks, the pipeline gets the remaining ones
+    data_block block;
+    while(load->exporter->pop_block(block))
+        if(pipeline_of_loading_) pipeline_of_loading_->push(block.x.data(), block.y.data(), block.x.size());
+
+    if(load->exporter->data_ptr())
+    {
+        //Data are plotted through the pyramid, so they are not copied
+        xy_data_ = load->exporter->data_ptr();
+        pyramid_ = load->pyramid;
+
+        //Loads without parsing pass no blocks, their data are pushed into the pipeline at once
+        if(pipeline_of_loading_ && pipeline_of_loading_->size() == 0)
+        {
+            const std::size_t nBlock = 1 << 16;
+            const xy_data& data = *xy_data_;
+            std::vector<double> x, y;
+            for(std::size_t first = 0; first < data.x().size(); first += nBlock)
+            {
+                std::size_t last = std::min(data.x().size(), first + nBlock);
+                x.assign(data.x().begin() + first, data.x().begin() + last);
+                y.assign(data.y().begin() + first, data.y().begin() + last);
+                pipeline_of_loading_->push(x.data(), y.data(), x.size());
+            }
+        }
         Q_EMIT this->dataChanged();
     }
+    if(pipeline_of_loading_) pipeline_of_loading_->finish();
+    Q_EMIT this->finished();
+}
+
+void app_data_handler::drop_data(quint64 job)
+{
+    if(!loading_ || loading_->job != job) return;
+    loading_.reset();
+    pipeline_of_loading_.reset();
+    Q_EMIT this->finished();
 }
@@ -1,19 +1,25 @@
 #ifndef APP_DATA_HANDLER_H
 #define APP_DATA_HANDLER_H
 
-#include <QThread>
+#include <QObject>
+#include <QScopedPointer>
 #include <QMap>
 #include <QSharedPointer>
+#include <QVector>
+
+#include "job_scheduler.h"
 
 class Approximator;
 class data_exporter;
+class minmax_pyramid;
+class peak_pipeline;
 class xy_data;
 using vector_data_type = QVector<double>;
 
 /**
- * Keeps application data and starts all data processes in a separate thread
+ * Keeps application data and runs all data processes as jobs of a scheduler
  */
-class app_data_handler : public QThread
+class app_data_handler : public QObject
 {
     Q_OBJECT
 
@@ -21,11 +27,39 @@ public:
     app_data_handler(QObject* parent = 0);
     virtual ~app_data_handler();
 
-    void run();
-
     const xy_data& data() const { return *this->xy_data_; }
+    QSharedPointer<const xy_data> data_ptr() const { return this->xy_data_; }
+
+    /**
+     * Min/max pyramid of the data for plotting, it is built by the loading job
+     */
+    QSharedPointer<const minmax_pyramid> pyramid() const { return this->pyramid_; }
+
+    /**
+     * Scheduler of loading, fitting, peak picking and export jobs
+     */
+    job_scheduler& scheduler() { return *this->scheduler_; }
+
+    /**
+     * Streaming mode: parsed blocks of points are emitted by data_appended while loading
+     */
+    void set_streaming(bool streaming) { streaming_ = streaming; }
+    bool streaming() const { return streaming_; }
+
+    /**
+     * Pipeline mode: parsed blocks of points are fitted and their peaks are picked while loading,
+     * peaks are emitted by peaks_found
+     */
+    void set_pipeline(bool pipeline, double smooth) { pipeline_ = pipeline; pipeline_smooth_ = smooth; }
+    bool pipeline() const { return pipeline_; }
 
 Q_SIGNALS:
+    /**
+     * Loading is started and finished
+     */
+    void started();
+    void finished();
+
     /**
      * Progress flow indicator
      */
@@ -43,29 +77,81 @@ Q_SIGNALS:
     void warning(QString msg);
 
     /**
-     * Emits new data
+     * Emits points of the first block in the streaming mode
      */
     void data_changed(const vector_data_type& x, const vector_data_type& y);
 
+    /**
+     * Emits points appended to the data in the streaming mode
+     */
+    void data_appended(const vector_data_type& x, const vector_data_type& y);
+
     /**
      * Notifies that data is ready
      */
     void dataChanged();
 
+    /**
+     * Emits peaks of data loaded in the pipeline mode
+     */
+    void peaks_found(quint64 job, QVector<double> positions, QVector<double> intensities);
+
+    /**
+     * Emitted by a loading job when it is finished
+     */
+    void loaded(quint64 job);
+
+    /**
+     * Emitted by a loading job when it fails
+     */
+    void load_failed(quint64 job);
+
 public Q_SLOTS:
     /**
-     * Load data from a file
+     * Load data from a file, a load in progress is superseded
      */
     void load_data(QString file_name);
 
     /**
-     * Get data from exporter
+     * Save data into a native binary file
+     */
+    void save_data(QString file_name);
+
+    /**
+     * Get data of a finished loading job
+     */
+    void get_data(quint64 job);
+
+    /**
+     * Drop a failed loading job, so loading is finished without data
+     */
+    void drop_data(quint64 job);
+
+    /**
+     * Get parsed blocks of points from exporter while loading
      */
-    void get_data();
+    void get_blocks();
 
 private:
+    /**
+     * Data of a loading job
+     */
+    struct loading
+    {
+        QSharedPointer<data_exporter> exporter;
+        QSharedPointer<const minmax_pyramid> pyramid;
+        job_scheduler::job_id job;
+    };
+
+    QScopedPointer<job_scheduler> scheduler_;
     QSharedPointer<xy_data> xy_data_;
-    QScopedPointer<data_exporter> data_exporter_;
+    QSharedPointer<const minmax_pyramid> pyramid_;
+    QSharedPointer<loading> loading_;
+    QScopedPointer<peak_pipeline> pipeline_of_loading_;
+    bool streaming_;
+    bool pipeline_;
+    double pipeline_smooth_;
+    bool first_block_;
 };
 
 #endif // APP_DATA_HANDLER_H
@@ -0,0 +1,204 @@
+#include "approximation_worker.h"
+#include "../app_data/app_data.h"
+
+#include <QMetaType>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+ApproximationWorker::ApproximationWorker(job_scheduler& scheduler, QObject* parent)
+    :
+      QObject(parent),
+      m_scheduler(scheduler),
+      m_nFitJob(0),
+      m_nGeneration(0),
+      m_fPreparedSmooth(0.0),
+      m_nFittedGeneration(0)
+{
+    qRegisterMetaType<QSharedPointer<const Approximator> >("QSharedPointer<const Approximator>");
+}
+
+ApproximationWorker::~ApproximationWorker()
+{
+    cancel();
+    for(job_scheduler::job_id nJob : m_vJobs) m_scheduler.cancel(nJob);
+    for(job_scheduler::job_id nJob : m_vJobs) m_scheduler.wait(nJob);
+}
+
+quint64 ApproximationWorker::fit(QSharedPointer<const xy_data> pData, Approximator::ApproximatorType type,
+                                 double fSmooth)
+{
+    //Fits are parallel by themselves, the scheduler runs them one by one and superseded ones return at once
+    quint64 nGeneration = ++m_nGeneration;
+    if(pData && !pData->x().empty())
+    {
+        m_nFitJob = submit
+        (
+            job_scheduler::FIT_JOB,
+            [this, nGeneration, pData, type, fSmooth](job_scheduler::context&)
+            {
+                run(nGeneration, pData, type, fSmooth);
+            }
+        );
+    }
+    return nGeneration;
+}
+
+void ApproximationWorker::findPeaks()
+{
+    submit
+    (
+        job_scheduler::PEAKS_JOB,
+        [this](job_scheduler::context&) { peaks(); },
+        std::vector<job_scheduler::job_id>(1, m_nFitJob)
+    );
+}
+
+void ApproximationWorker::chooseSmoothing(double fNoise)
+{
+    //The choice uses equations of the fit, so it is a fit job run one by one with refits of them
+    submit
+    (
+        job_scheduler::FIT_JOB,
+        [this, fNoise](job_scheduler::context&) { smoothing(fNoise); },
+        std::vector<job_scheduler::job_id>(1, m_nFitJob)
+    );
+}
+
+job_scheduler::job_id ApproximationWorker::submit(job_scheduler::job_type type, job_scheduler::job_function fun,
+                                                  const std::vector<job_scheduler::job_id>& vAfter)
+{
+    //Finished jobs are forgotten, so the list is as short as the queue of requests
+    m_vJobs.erase(std::remove_if(m_vJobs.begin(), m_vJobs.end(),
+                                 [this](job_scheduler::job_id nJob) { return !m_scheduler.active(nJob); }),
+                  m_vJobs.end());
+    job_scheduler::job_id nJob = m_scheduler.submit(type, fun, vAfter);
+    m_vJobs.push_back(nJob);
+    return nJob;
+}
+
+void ApproximationWorker::cancel()
+{
+    ++m_nGeneration;
+}
+
+quint64 ApproximationWorker::generation() const
+{
+    return m_nGeneration;
+}
+
+bool ApproximationWorker::isCurrent(quint64 nGeneration) const
+{
+    return nGeneration == m_nGeneration;
+}
+
+void ApproximationWorker::run(quint64 nGeneration, const QSharedPointer<const xy_data>& pData,
+                              Approximator::ApproximatorType type, double fSmooth)
+{
+    if(!isCurrent(nGeneration)) return;
+    double fPreparedSmooth = fSmooth;
+    QSharedPointer<const Approximator> pApproximator = prepared(nGeneration, pData, type, fPreparedSmooth);
+    if(!pApproximator || !isCurrent(nGeneration)) return;
+
+    if(fPreparedSmooth != fSmooth)
+    {
+        Approximator* pRefitted = pApproximator->refitted(fSmooth);
+        if(pRefitted) pApproximator.reset(pRefitted);
+    }
+
+    double fStd = 0.0;
+    if(!deviation(nGeneration, *pData, *pApproximator, fStd)) return;
+    if(!isCurrent(nGeneration)) return;
+    {
+        QMutexLocker lock(&m_fittedMutex);
+        m_pFitted = pApproximator;
+        m_nFittedGeneration = nGeneration;
+    }
+    Q_EMIT fitted(nGeneration, pApproximator, fStd);
+}
+
+QSharedPointer<const Approximator> ApproximationWorker::latest(quint64& nGeneration)
+{
+    QMutexLocker lock(&m_fittedMutex);
+    nGeneration = m_nFittedGeneration;
+    return m_pFitted;
+}
+
+void ApproximationWorker::peaks()
+{
+    quint64 nGeneration;
+    QSharedPointer<const Approximator> pApproximator = latest(nGeneration);
+    if(!pApproximator) return;
+
+    Approximator::Vector vPositions, vIntensities;
+    pApproximator->findPeaks(vPositions, vIntensities);
+    Q_EMIT peaksFound(nGeneration, QVector<double>::fromStdVector(vPositions),
+                      QVector<double>::fromStdVector(vIntensities));
+}
+
+void ApproximationWorker::smoothing(double fNoise)
+{
+    quint64 nGeneration;
+    QSharedPointer<const Approximator> pApproximator = latest(nGeneration);
+    if(!pApproximator || !isCurrent(nGeneration)) return;
+    Q_EMIT smoothingChosen(nGeneration, pApproximator->optimalSmoothing(fNoise));
+}
+
+QSharedPointer<const Approximator> ApproximationWorker::prepared(quint64 nGeneration,
+                                                                 const QSharedPointer<const xy_data>& pData,
+                                                                 Approximator::ApproximatorType type,
+                                                                 double& fSmooth)
+{
+    QMutexLocker lock(&m_prepareMutex);
+    if(m_pPrepared && m_pPrepared->type() == type && m_pPreparedData.toStrongRef() == pData)
+    {
+        fSmooth = m_fPreparedSmooth;
+        return m_pPrepared;
+    }
+    if(!isCurrent(nGeneration)) return QSharedPointer<const Approximator>();
+
+    //Equations of previous data are dropped before new ones are prepared
+    m_pPrepared.reset();
+    const data_column& x = pData->x();
+    const data_column& y = pData->y();
+    {
+        //Data are shared with other threads, so the fit is made from private dense copies which are freed after
+        Approximator::Vector vX(x.begin(), x.end()), vY(y.begin(), y.end());
+
+        //Uniform grid of x-values enables fast paths of approximators
+        CubicSplineApproximator::CubicSplineParams params(vX, vY, fSmooth, x.is_uniform() ? x.step() : 0.0);
+        m_pPrepared.reset(Approximator::create(type, params));
+    }
+    m_pPreparedData = pData;
+    m_fPreparedSmooth = fSmooth;
+    return m_pPrepared;
+}
+
+bool ApproximationWorker::deviation(quint64 nGeneration, const xy_data& data, const Approximator& approximator,
+                                    double& fStd) const
+{
+    //Deviations are accumulated by blocks straight from data columns, a superseded request stops between blocks
+    const std::size_t nBlock = 1 << 16;
+    const data_column& x = data.x();
+    const data_column& y = data.y();
+    const data_column& w = data.w();
+    const bool bWeighted = !w.empty();
+    double yy = 0.0, yy2 = 0.0, norm = 0.0;
+    Approximator::Vector vX;
+    for(std::size_t nFirst = 0; nFirst < y.size(); nFirst += nBlock)
+    {
+        if(!isCurrent(nGeneration)) return false;
+        std::size_t n = qMin(nBlock, y.size() - nFirst);
+        vX.assign(x.begin() + nFirst, x.begin() + nFirst + n);
+        Approximator::Vector vY = approximator.approximate(vX);
+        data_column::const_iterator itY = y.begin() + nFirst, itW = w.begin() + nFirst;
+        for(std::size_t i = 0; i < n; ++i, ++itY)
+        {
+            double dy = *itY - vY[i], weight = bWeighted ? *itW++ : 1.0;
+            yy += weight * dy; yy2 += weight * dy * dy;
+            norm += weight;
+        }
+    }
+    fStd = (yy2 - yy*yy)/norm;
+    return true;
+}
@@ -0,0 +1,152 @@
+#ifndef APPROXIMATION_WORKER_H
+#define APPROXIMATION_WORKER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+#include <QWeakPointer>
+
+#include <atomic>
+
+#include "approximator_factory.h"
+#include "job_scheduler.h"
+
+class xy_data;
+
+/**
+ * @brief The ApproximationWorker class fits approximators of data by jobs of a scheduler. Every request
+ * gets a generation number and supersedes all older requests: their fits are skipped when they are
+ * taken from the queue or dropped at the next stage, so only a result of the latest request comes
+ * back by the fitted signal. Equations prepared for data and a type of approximator are kept,
+ * changes of smoothing only refit them. Peaks are picked and smoothing is chosen by jobs run after the latest fit
+ */
+class ApproximationWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ApproximationWorker(job_scheduler& scheduler, QObject* parent = 0);
+
+    /**
+     * Cancels requests in flight and waits for running jobs
+     */
+    ~ApproximationWorker();
+
+    /**
+     * @brief fit requests an approximation of data in background
+     * @param pData
+     * @param type
+     * @param fSmooth
+     * @return generation of the request
+     */
+    quint64 fit(QSharedPointer<const xy_data> pData, Approximator::ApproximatorType type, double fSmooth);
+
+    /**
+     * @brief findPeaks requests peaks of the latest approximation, they are picked after a fit in flight
+     */
+    void findPeaks();
+
+    /**
+     * @brief chooseSmoothing requests smoothing chosen by the latest approximation, it is chosen after a fit in flight
+     * @param fNoise noise level of the data or zero for generalised cross validation
+     */
+    void chooseSmoothing(double fNoise);
+
+    /**
+     * @brief cancel supersedes all requests in flight
+     */
+    void cancel();
+
+    /**
+     * @brief generation
+     * @return generation of the latest request
+     */
+    quint64 generation() const;
+
+Q_SIGNALS:
+    /**
+     * @brief fitted delivers an approximator of a request together with a standard deviation
+     * of the data from it
+     * @param nGeneration generation of the request, a result is current if it equals generation()
+     * @param pApproximator
+     * @param fStd
+     */
+    void fitted(quint64 nGeneration, QSharedPointer<const Approximator> pApproximator, double fStd);
+
+    /**
+     * @brief peaksFound delivers maximums of an approximation with approximated values at them
+     * @param nGeneration generation of the request the approximation is fitted for
+     * @param vPositions
+     * @param vIntensities
+     */
+    void peaksFound(quint64 nGeneration, QVector<double> vPositions, QVector<double> vIntensities);
+
+    /**
+     * @brief smoothingChosen delivers smoothing chosen by an approximation
+     * @param nGeneration generation of the request the approximation is fitted for
+     * @param fSmooth chosen smoothing or zero if the approximator does not choose it
+     */
+    void smoothingChosen(quint64 nGeneration, double fSmooth);
+
+private:
+    job_scheduler& m_scheduler;
+    job_scheduler::job_id m_nFitJob;
+    std::vector<job_scheduler::job_id> m_vJobs; ///<submitted jobs which may be active
+    std::atomic<quint64> m_nGeneration;
+
+    QMutex m_prepareMutex;                      ///<guards prepared approximator
+    QWeakPointer<const xy_data> m_pPreparedData;
+    QSharedPointer<const Approximator> m_pPrepared;
+    double m_fPreparedSmooth;
+
+    QMutex m_fittedMutex;                       ///<guards the latest approximation
+    QSharedPointer<const Approximator> m_pFitted;
+    quint64 m_nFittedGeneration;
+
+    bool isCurrent(quint64 nGeneration) const;
+
+    /**
+     * @brief run fits an approximator of a request in a thread of a job
+     */
+    void run(quint64 nGeneration, const QSharedPointer<const xy_data>& pData,
+             Approximator::ApproximatorType type, double fSmooth);
+
+    /**
+     * @brief prepared returns an approximator of data and type with prepared equations, it is created
+     * if data or type differ from the ones of the previous request
+     * @param fSmooth smoothing of a request, it is set to smoothing the approximator is fitted with
+     * @return prepared approximator or null if the request is superseded
+     */
+    QSharedPointer<const Approximator> prepared(quint64 nGeneration, const QSharedPointer<const xy_data>& pData,
+                                                Approximator::ApproximatorType type, double& fSmooth);
+
+    /**
+     * @brief submit submits a job of the worker
+     */
+    job_scheduler::job_id submit(job_scheduler::job_type type, job_scheduler::job_function fun,
+                                 const std::vector<job_scheduler::job_id>& vAfter = std::vector<job_scheduler::job_id>());
+
+    /**
+     * @brief latest returns the latest approximation and generation of its request
+     */
+    QSharedPointer<const Approximator> latest(quint64& nGeneration);
+
+    /**
+     * @brief peaks picks peaks of the latest approximation in a thread of a job
+     */
+    void peaks();
+
+    /**
+     * @brief smoothing chooses smoothing by the latest approximation in a thread of a job
+     */
+    void smoothing(double fNoise);
+
+    /**
+     * @brief deviation computes the standard deviation of the data from an approximation
+     * @return false if the request is superseded
+     */
+    bool deviation(quint64 nGeneration, const xy_data& data, const Approximator& approximator, double& fStd) const;
+};
+
+#endif // APPROXIMATION_WORKER_H
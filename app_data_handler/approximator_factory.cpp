@@ -1,9 +1,15 @@
 #include "../app_data_handler/approximator_factory.h"
 
-Approximator::Params::Params(const Vector &vXVals, const Vector &vYVals)
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+
+Approximator::Params::Params(const Vector &vXVals, const Vector &vYVals, double fStep)
     :
       m_vXVals(vXVals),
-      m_vYVals(vYVals)
+      m_vYVals(vYVals),
+      m_fStep(fStep)
 {
 }
 
@@ -18,6 +24,11 @@ const Approximator::Vector& Approximator::Params::y() const
     return m_vYVals;
 }
 
+double Approximator::Params::step() const
+{
+    return m_fStep;
+}
+
 Approximator* Approximator::create(ApproximatorType type, const Params& params)
 {
     switch(type)
@@ -38,19 +49,42 @@ Approximator* Approximator::create(ApproximatorType type, const Params& params)
             static_cast<const CubicSplineApproximator::CubicSplineParams&>(params)
         );
     default:
-        return Q_NULLPTR;
+        return nullptr;
     }
 }
 
+void Approximator::findPeaks(Vector& vPositions, Vector& vIntensities) const
+{
+    vPositions = getPeaks();
+    vIntensities = approximate(vPositions);
+}
+
+bool Approximator::setSmoothing(double)
+{
+    return false;
+}
+
+Approximator* Approximator::refitted(double) const
+{
+    return nullptr;
+}
+
+double Approximator::optimalSmoothing(double) const
+{
+    return 0.0;
+}
+
 Approximator::ApproximatorType CubicSplineApproximator::type() const
 {
     return CubicSplineType;
 }
 
-CubicSplineApproximator::CubicSplineParams::CubicSplineParams(const Vector &vXVals, const Vector &vYVals, double fSmooth)
+CubicSplineApproximator::CubicSplineParams::CubicSplineParams(const Vector &vXVals, const Vector &vYVals, double fSmooth, double fStep,
+                                                              size_t nWindow)
     :
-      Approximator::Params(vXVals, vYVals),
-      m_fSmooth(fSmooth)
+      Approximator::Params(vXVals, vYVals, fStep),
+      m_fSmooth(fSmooth),
+      m_nWindow(nWindow)
 {}
 
 double CubicSplineApproximator::CubicSplineParams::smooth() const
@@ -58,11 +92,43 @@ double CubicSplineApproximator::CubicSplineParams::smooth() const
     return m_fSmooth;
 }
 
+size_t CubicSplineApproximator::CubicSplineParams::window() const
+{
+    return m_nWindow;
+}
+
 CubicSplineApproximator::CubicSplineApproximator(const CubicSplineParams& params)
     :
-      m_pSpline(new Spline(params.x(), params.y(), params.smooth()))
+      m_pFitter(createFitter(params)),
+      m_pSpline(new Spline(*m_pFitter, params.smooth()))
 {}
 
+CubicSplineApproximator::CubicSplineApproximator(const std::shared_ptr<const Fitter>& pFitter, double fSmooth)
+    :
+      m_pFitter(pFitter),
+      m_pSpline(new Spline(*m_pFitter, fSmooth))
+{}
+
+CubicSplineApproximator::Fitter* CubicSplineApproximator::createFitter(const Params& params)
+{
+    size_t N = std::min(params.x().size(), params.y().size());
+    Vector::const_iterator xEnd = params.x().begin() + N;
+    if(std::adjacent_find(params.x().begin(), xEnd, std::greater_equal<double>()) == xEnd)
+        return new Fitter(N, params.x().data(), params.y().data());
+
+    std::map<double, double> mapXYData;
+    for(size_t i = 0; i < N; ++i) mapXYData[params.x()[i]] = params.y()[i];
+    Vector vXVals, vYVals;
+    vXVals.reserve(mapXYData.size());
+    vYVals.reserve(mapXYData.size());
+    for(const auto& xy : mapXYData)
+    {
+        vXVals.push_back(xy.first);
+        vYVals.push_back(xy.second);
+    }
+    return new Fitter(vXVals.size(), vXVals.data(), vYVals.data());
+}
+
 Approximator::Vector CubicSplineApproximator::approximate(const Vector& vXVals) const
 {
     return m_pSpline->poly().estimate_y_vals(vXVals);
@@ -73,6 +139,22 @@ Approximator::Vector CubicSplineApproximator::getPeaks() const
     return m_pSpline->poly().get_maxs();
 }
 
+bool CubicSplineApproximator::setSmoothing(double fSmooth)
+{
+    m_pSpline.reset(new Spline(*m_pFitter, fSmooth));
+    return true;
+}
+
+Approximator* CubicSplineApproximator::refitted(double fSmooth) const
+{
+    return new CubicSplineApproximator(m_pFitter, fSmooth);
+}
+
+double CubicSplineApproximator::optimalSmoothing(double fNoise) const
+{
+    return fNoise > 0.0 ? m_pFitter->noise_smoothing(fNoise) : m_pFitter->gcv_smoothing();
+}
+
 Approximator::ApproximatorType CubicSplineApproximatorNew::type() const
 {
     return CubicSplineNewType;
@@ -83,21 +165,52 @@ CubicSplineApproximatorNew::CubicSplineApproximatorNew
     const CubicSplineApproximator::CubicSplineParams &params
 )
     :
-      m_pSpline(new StandartPeacewisePoly(params.x(), params.y(), params.smooth()))
+      m_pFitter(CubicSplineApproximator::createFitter(params)),
+      m_pSpline(new StandartPeacewisePoly(*m_pFitter, params.smooth(), params.window())),
+      m_nWindow(params.window())
+{}
+
+CubicSplineApproximatorNew::CubicSplineApproximatorNew
+(
+    const std::shared_ptr<const Fitter>& pFitter, double fSmooth, size_t nWindow
+)
+    :
+      m_pFitter(pFitter),
+      m_pSpline(new StandartPeacewisePoly(*m_pFitter, fSmooth, nWindow)),
+      m_nWindow(nWindow)
 {}
 
 Approximator::Vector CubicSplineApproximatorNew::approximate(const Vector& vXVals) const
 {
-    Vector y(vXVals.size());
-    for(size_t i = 0; i < y.size(); ++i){
-        y[i] = (*m_pSpline)(vXVals[i]);
-    }
-    return y;
+    return (*m_pSpline)(vXVals);
 }
 
 Approximator::Vector CubicSplineApproximatorNew::getPeaks() const
 {
-    return Vector();
+    Vector vPositions, vIntensities;
+    m_pSpline->findMaxs(vPositions, vIntensities);
+    return vPositions;
+}
+
+void CubicSplineApproximatorNew::findPeaks(Vector& vPositions, Vector& vIntensities) const
+{
+    m_pSpline->findMaxs(vPositions, vIntensities);
+}
+
+bool CubicSplineApproximatorNew::setSmoothing(double fSmooth)
+{
+    m_pSpline.reset(new StandartPeacewisePoly(*m_pFitter, fSmooth, m_nWindow));
+    return true;
+}
+
+Approximator* CubicSplineApproximatorNew::refitted(double fSmooth) const
+{
+    return new CubicSplineApproximatorNew(m_pFitter, fSmooth, m_nWindow);
+}
+
+double CubicSplineApproximatorNew::optimalSmoothing(double fNoise) const
+{
+    return fNoise > 0.0 ? m_pFitter->noise_smoothing(fNoise) : m_pFitter->gcv_smoothing();
 }
 
 Approximator::ApproximatorType CubicSplineEqualStepSizeApproximator::type() const
@@ -109,27 +222,62 @@ CubicSplineEqualStepSizeApproximator::CubicSplineEqualStepSizeApproximator
 (
     const CubicSplineApproximator::CubicSplineParams &params
 )
+    :
+      m_pFitter(CubicSplineApproximator::createFitter(params)),
+      m_nWindow(params.window())
 {
-    double h = params.x()[1] - params.x()[0];
-    for(size_t i = 1; i < params.x().size() - 1; ++i)
+    //A known step of equally spaced data saves the search for the minimal one
+    double h = params.step() > 0.0 ? params.step() : params.x()[1] - params.x()[0];
+    for(size_t i = 1; params.step() <= 0.0 && i < params.x().size() - 1; ++i)
     {
-        h = qMin(h, qAbs(params.x()[i+1] - params.x()[i]));
+        h = std::min(h, std::abs(params.x()[i+1] - params.x()[i]));
     }
-    StandartPeacewisePoly tSpline(params.x(), params.y(), params.smooth());
-    m_pSpline.reset(new EqualStepPeacewisePoly(tSpline, h));
+    m_fH = h;
+    setSmoothing(params.smooth());
+}
+
+CubicSplineEqualStepSizeApproximator::CubicSplineEqualStepSizeApproximator
+(
+    const std::shared_ptr<const Fitter>& pFitter, double fH, double fSmooth, size_t nWindow
+)
+    :
+      m_pFitter(pFitter),
+      m_fH(fH),
+      m_nWindow(nWindow)
+{
+    setSmoothing(fSmooth);
 }
 
 Approximator::Vector CubicSplineEqualStepSizeApproximator::approximate(const Vector &vXVals) const
 {
-    Vector vYVals(vXVals.size());
-    for(size_t i = 0; i < vXVals.size(); ++i)
-    {
-        vYVals[i] = (*m_pSpline)(vXVals[i]);
-    }
-    return vYVals;
+    return (*m_pSpline)(vXVals);
 }
 
 Approximator::Vector CubicSplineEqualStepSizeApproximator::getPeaks() const
 {
-    return Vector();
+    Vector vPositions, vIntensities;
+    m_pSpline->findMaxs(vPositions, vIntensities);
+    return vPositions;
+}
+
+void CubicSplineEqualStepSizeApproximator::findPeaks(Vector& vPositions, Vector& vIntensities) const
+{
+    m_pSpline->findMaxs(vPositions, vIntensities);
+}
+
+bool CubicSplineEqualStepSizeApproximator::setSmoothing(double fSmooth)
+{
+    StandartPeacewisePoly tSpline(*m_pFitter, fSmooth, m_nWindow);
+    m_pSpline.reset(new EqualStepPeacewisePoly(tSpline, m_fH));
+    return true;
+}
+
+Approximator* CubicSplineEqualStepSizeApproximator::refitted(double fSmooth) const
+{
+    return new CubicSplineEqualStepSizeApproximator(m_pFitter, m_fH, fSmooth, m_nWindow);
+}
+
+double CubicSplineEqualStepSizeApproximator::optimalSmoothing(double fNoise) const
+{
+    return fNoise > 0.0 ? m_pFitter->noise_smoothing(fNoise) : m_pFitter->gcv_smoothing();
 }
@@ -1,7 +1,7 @@
 #ifndef APPROXIMATOR_FACTORY_H
 #define APPROXIMATOR_FACTORY_H
 
-#include <QScopedPointer>
+#include <memory>
 
 #include "../app_data/math/spline.h"
 #include "../new_math/peacewisepoly.h"
@@ -23,13 +23,18 @@ public:
     {
         const Vector& m_vXVals;
         const Vector& m_vYVals;
+        const double m_fStep;
     public:
 
-        Params(const Vector& vXVals, const Vector& vYVals);
+        /**
+         * fStep is a step of equally spaced x-values or zero if x-values are not equally spaced
+         */
+        Params(const Vector& vXVals, const Vector& vYVals, double fStep = 0.0);
         virtual ~Params(){}
 
         const Vector& x() const;
         const Vector& y() const;
+        double step() const;
     };
 
     /**
@@ -58,6 +63,36 @@ public:
      * @return maximums positions
      */
     virtual Vector getPeaks() const = 0;
+
+    /**
+     * @brief findPeaks looks for maximums together with approximated values at them
+     * @param vPositions maximums positions
+     * @param vIntensities approximated values at maximums
+     */
+    virtual void findPeaks(Vector& vPositions, Vector& vIntensities) const;
+
+    /**
+     * @brief setSmoothing refits the approximation of the same data with a new smoothing parameter
+     * @param fSmooth
+     * @return false if the approximator does not support refitting and has to be created again
+     */
+    virtual bool setSmoothing(double fSmooth);
+
+    /**
+     * @brief refitted creates an approximation of the same data with a new smoothing parameter,
+     * prepared equations are shared, so approximators refitted in different threads are independent
+     * @param fSmooth
+     * @return approximator to be deleted by a caller or null if the approximator does not support refitting
+     */
+    virtual Approximator* refitted(double fSmooth) const;
+
+    /**
+     * @brief optimalSmoothing chooses a smoothing parameter for the data of the approximator
+     * @param fNoise standard deviation of noise in y-values, if it is not positive the parameter
+     * minimising generalised cross validation score is chosen
+     * @return smoothing parameter or zero if the approximator cannot choose it
+     */
+    virtual double optimalSmoothing(double fNoise = 0.0) const;
 };
 
 /**
@@ -66,9 +101,13 @@ public:
 class CubicSplineApproximator : public Approximator
 {
     using Spline = cubic_spline<double>;
-    using PSpline = QScopedPointer<Spline>;
+    using PSpline = std::unique_ptr<Spline>;
+    using Fitter = math::cubic_spline_fitter<double>;
 
+    std::shared_ptr<const Fitter> m_pFitter;
     PSpline m_pSpline;
+
+    CubicSplineApproximator(const std::shared_ptr<const Fitter>& pFitter, double fSmooth);
 public:
 
     ApproximatorType type() const;
@@ -76,11 +115,19 @@ public:
     class CubicSplineParams : public Approximator::Params
     {
         const double m_fSmooth;
+        const size_t m_nWindow;
     public:
 
-        CubicSplineParams(const Vector &vXVals, const Vector &vYVals, double fSmooth);
+        /**
+         * @param nWindow spectra longer than this number of points are fitted by overlapping windows concurrently,
+         * zero fits all points at once
+         */
+        CubicSplineParams(const Vector &vXVals, const Vector &vYVals, double fSmooth, double fStep = 0.0,
+                          size_t nWindow = 0);
 
         double smooth() const;
+
+        size_t window() const;
     };
 
     CubicSplineApproximator(const CubicSplineParams& params);
@@ -88,13 +135,37 @@ public:
     Vector approximate(const Vector &x) const;
 
     Vector getPeaks() const;
+
+    bool setSmoothing(double fSmooth);
+
+    Approximator* refitted(double fSmooth) const;
+
+    double optimalSmoothing(double fNoise = 0.0) const;
+
+    /**
+     * Suggested window of segmented fits, windows are widened to follow strong smoothing
+     */
+    static const size_t nSegmentWindow = 1 << 20;
+
+    /**
+     * @brief createFitter prepares spline fitting of parameters data,
+     * x-values are sorted and duplicates are dropped if needed
+     * @param params
+     * @return fitting to be deleted by a caller
+     */
+    static Fitter* createFitter(const Params& params);
 };
 
 class CubicSplineApproximatorNew : public Approximator
 {
     using Spline = StandartPeacewisePoly;
-    using PSpline = QScopedPointer<Spline>;
+    using PSpline = std::unique_ptr<Spline>;
+    using Fitter = math::cubic_spline_fitter<double>;
+    std::shared_ptr<const Fitter> m_pFitter;
     PSpline m_pSpline;
+    size_t m_nWindow;
+
+    CubicSplineApproximatorNew(const std::shared_ptr<const Fitter>& pFitter, double fSmooth, size_t nWindow);
 public:
 
     ApproximatorType type() const;
@@ -104,13 +175,28 @@ public:
     Vector approximate(const Vector& vXVals) const;
 
     Vector getPeaks() const;
+
+    void findPeaks(Vector& vPositions, Vector& vIntensities) const;
+
+    bool setSmoothing(double fSmooth);
+
+    Approximator* refitted(double fSmooth) const;
+
+    double optimalSmoothing(double fNoise = 0.0) const;
 };
 
 class CubicSplineEqualStepSizeApproximator : public Approximator
 {
     using Spline = EqualStepPeacewisePoly;
-    using PSpline= QScopedPointer<Spline>;
+    using PSpline= std::unique_ptr<Spline>;
+    using Fitter = math::cubic_spline_fitter<double>;
+    std::shared_ptr<const Fitter> m_pFitter;
     PSpline m_pSpline;
+    double m_fH;
+    size_t m_nWindow;
+
+    CubicSplineEqualStepSizeApproximator(const std::shared_ptr<const Fitter>& pFitter, double fH, double fSmooth,
+                                         size_t nWindow);
 public:
 
     ApproximatorType type() const;
@@ -120,6 +206,14 @@ public:
     Vector approximate(const Vector &vXVals) const;
 
     Vector getPeaks() const;
+
+    void findPeaks(Vector& vPositions, Vector& vIntensities) const;
+
+    bool setSmoothing(double fSmooth);
+
+    Approximator* refitted(double fSmooth) const;
+
+    double optimalSmoothing(double fNoise = 0.0) const;
 };
 
 #endif // APPROXIMATOR_FACTORY_H
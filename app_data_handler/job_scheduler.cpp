@@ -0,0 +1,257 @@
+#include "job_scheduler.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace
+{
+    //Scheduler and queue of a worker thread
+    thread_local const job_scheduler* current_scheduler = nullptr;
+    thread_local std::size_t current_queue = 0;
+}
+
+job_scheduler::job_id job_scheduler::context::id() const
+{
+    return job_.id;
+}
+
+void job_scheduler::context::progress(int val)
+{
+    if(job_.on_progress) job_.on_progress(val);
+}
+
+bool job_scheduler::context::cancelled() const
+{
+    return job_.cancelled;
+}
+
+job_scheduler::job_scheduler(size_t threads)
+    :
+      queued_(0),
+      next_queue_(0),
+      last_id_(0),
+      stop_(false)
+{
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    std::fill(limits_, limits_ + JOB_TYPES, size_t(0));
+    std::fill(running_, running_ + JOB_TYPES, size_t(0));
+    for(size_t i = 0; i < threads; ++i) queues_.emplace_back(new worker_queue);
+    for(size_t i = 0; i < threads; ++i) threads_.emplace_back(&job_scheduler::work_, this, i);
+}
+
+job_scheduler::~job_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& j : jobs_) j.second->cancelled = true;
+    }
+    wait_all();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto& t : threads_) t.join();
+}
+
+void job_scheduler::set_limit(job_type type, size_t limit)
+{
+    std::vector<job_ptr> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limits_[type] = limit;
+        while(!deferred_[type].empty() && (limit == 0 || running_[type] + ready.size() < limit))
+        {
+            ready.push_back(deferred_[type].front());
+            deferred_[type].pop_front();
+        }
+    }
+    for(const job_ptr& j : ready) push_(j);
+}
+
+void job_scheduler::set_failure_handler(failure_function handler)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    on_failure_ = std::move(handler);
+}
+
+job_scheduler::job_id job_scheduler::submit(job_type type, job_function fun, const std::vector<job_id>& after,
+                                            progress_function progress)
+{
+    job_ptr j = std::make_shared<job>();
+    j->type = type;
+    j->fun = std::move(fun);
+    j->on_progress = std::move(progress);
+    j->pending = 0;
+    j->cancelled = false;
+
+    bool ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        j->id = ++last_id_;
+        for(job_id id : after)
+        {
+            auto it = jobs_.find(id);
+            if(it == jobs_.end()) continue;
+            if(it->second->cancelled) j->cancelled = true;
+            it->second->dependents.push_back(j);
+            ++j->pending;
+        }
+        jobs_[j->id] = j;
+        ready = j->pending == 0;
+    }
+    if(ready) push_(j);
+    return j->id;
+}
+
+void job_scheduler::cancel(job_id id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if(it != jobs_.end()) it->second->cancelled = true;
+}
+
+bool job_scheduler::active(job_id id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.find(id) != jobs_.end();
+}
+
+void job_scheduler::wait(job_id id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this, id] { return jobs_.find(id) == jobs_.end(); });
+}
+
+void job_scheduler::wait_all()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return jobs_.empty(); });
+}
+
+void job_scheduler::work_(size_t index)
+{
+    current_scheduler = this;
+    current_queue = index;
+    for(;;)
+    {
+        job_ptr j = take_(index);
+        if(j)
+        {
+            run_(j);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if(stop_) return;
+    }
+}
+
+void job_scheduler::push_(const job_ptr& j)
+{
+    //Jobs submitted by a job are likely to use its data, so they are kept on its worker
+    size_t index = current_scheduler == this ? current_queue : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->jobs.push_back(j);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+job_scheduler::job_ptr job_scheduler::take_(size_t index)
+{
+    for(size_t k = 0; k < queues_.size(); ++k)
+    {
+        worker_queue& queue = *queues_[(index + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.jobs.empty()) continue;
+        job_ptr j;
+        if(k == 0)
+        {
+            j = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            j = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        --queued_;
+        return j;
+    }
+    return job_ptr();
+}
+
+void job_scheduler::run_(const job_ptr& j)
+{
+    {
+        //A job over the limit waits for a finished job of its type
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t limit = limits_[j->type];
+        if(!j->cancelled && limit != 0 && running_[j->type] >= limit)
+        {
+            deferred_[j->type].push_back(j);
+            return;
+        }
+        ++running_[j->type];
+    }
+    if(!j->cancelled)
+    {
+        context ctx(*j);
+        try
+        {
+            j->fun(ctx);
+        }
+        catch(const std::exception& e)
+        {
+            fail_(j, e.what());
+        }
+        catch(...)
+        {
+            fail_(j, "Unknown error.");
+        }
+    }
+    finish_(j);
+}
+
+void job_scheduler::fail_(const job_ptr& j, const std::string& what)
+{
+    j->cancelled = true;
+    failure_function on_failure;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        on_failure = on_failure_;
+    }
+    if(on_failure) on_failure(j->id, j->type, what);
+}
+
+void job_scheduler::finish_(const job_ptr& j)
+{
+    //Data captured by the job are released out of the lock
+    job_function fun;
+    std::vector<job_ptr> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t limit = limits_[j->type];
+        --running_[j->type];
+        if(!deferred_[j->type].empty() && (limit == 0 || running_[j->type] < limit))
+        {
+            ready.push_back(deferred_[j->type].front());
+            deferred_[j->type].pop_front();
+        }
+        for(const job_ptr& d : j->dependents)
+        {
+            if(j->cancelled) d->cancelled = true;
+            if(--d->pending == 0) ready.push_back(d);
+        }
+        j->dependents.clear();
+        fun.swap(j->fun);
+        jobs_.erase(j->id);
+    }
+    done_.notify_all();
+    for(const job_ptr& r : ready) push_(r);
+}
@@ -0,0 +1,161 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of worker threads running typed jobs. A worker takes jobs from the back of its own queue and steals
+ * them from the front of queues of other workers, jobs submitted by a job go to the queue of its worker.
+ * A job may run after other jobs, it is queued when all of them are finished. A number of running jobs
+ * of a type can be bounded, so e.g. fits parallel by themselves do not compete for cores
+ */
+class job_scheduler
+{
+    struct job;
+    using job_ptr = std::shared_ptr<job>;
+
+public:
+    using size_t = std::size_t;
+
+    /**
+     * Identifier of a submitted job, zero is not a job
+     */
+    using job_id = std::size_t;
+
+    enum job_type
+    {
+        LOAD_JOB = 0,
+        FIT_JOB,
+        PEAKS_JOB,
+        EXPORT_JOB,
+        JOB_TYPES
+    };
+
+    /**
+     * Interface of a running job
+     */
+    class context
+    {
+        friend class job_scheduler;
+        job& job_;
+        explicit context(job& j) : job_(j) {}
+    public:
+        job_id id() const;
+
+        /**
+         * Reports progress of the job in percents to its progress function
+         */
+        void progress(int val);
+
+        /**
+         * A job cancelled while running may stop early
+         */
+        bool cancelled() const;
+    };
+
+    using job_function = std::function<void(context&)>;
+    using progress_function = std::function<void(int)>;
+
+    /**
+     * Receives a job which threw an exception and a description of the exception
+     */
+    using failure_function = std::function<void(job_id, job_type, const std::string&)>;
+
+    /**
+     * Starts the pool of threads, all cores are used if threads is zero
+     */
+    explicit job_scheduler(size_t threads = 0);
+
+    /**
+     * Cancels all jobs and waits for running ones
+     */
+    ~job_scheduler();
+
+    size_t threads() const { return threads_.size(); }
+
+    /**
+     * Bounds the number of running jobs of a type, zero is no bound
+     */
+    void set_limit(job_type type, size_t limit);
+
+    /**
+     * Is called from the thread of a job which threw an exception, the job is dropped like a cancelled one
+     */
+    void set_failure_handler(failure_function handler);
+
+    /**
+     * Submits a job to be run after jobs of after. A job after a cancelled or failed job is cancelled,
+     * jobs finished before the submission are skipped whatever their result, as are unknown jobs.
+     * A progress function is called from a thread of the job
+     */
+    job_id submit(job_type type, job_function fun, const std::vector<job_id>& after = std::vector<job_id>(),
+                  progress_function progress = progress_function());
+
+    /**
+     * Cancels a job, it is dropped if it is not started. Jobs running after a cancelled or failed job
+     * are cancelled as well
+     */
+    void cancel(job_id id);
+
+    /**
+     * A job is queued or running
+     */
+    bool active(job_id id) const;
+
+    /**
+     * Waits for a job or all jobs to be finished or dropped, must not be called from jobs
+     */
+    void wait(job_id id);
+    void wait_all();
+
+private:
+    struct job
+    {
+        job_id id;
+        job_type type;
+        job_function fun;
+        progress_function on_progress;
+        size_t pending;                 //unfinished jobs to be run after
+        std::vector<job_ptr> dependents;
+        std::atomic<bool> cancelled;
+    };
+
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<job_ptr> jobs;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_;        //jobs in worker queues
+    std::atomic<size_t> next_queue_;    //queue for jobs submitted outside of workers
+
+    mutable std::mutex mutex_;          //guards jobs, counters of running jobs and deferred jobs
+    std::condition_variable wake_, done_;
+    std::map<job_id, job_ptr> jobs_;    //unfinished jobs
+    failure_function on_failure_;
+    size_t limits_[JOB_TYPES];
+    size_t running_[JOB_TYPES];
+    std::deque<job_ptr> deferred_[JOB_TYPES]; //ready jobs over the limit of their type
+    job_id last_id_;
+    bool stop_;
+
+    void work_(size_t index);
+    void push_(const job_ptr& j);
+    job_ptr take_(size_t index);
+    void run_(const job_ptr& j);
+    void fail_(const job_ptr& j, const std::string& what);
+    void finish_(const job_ptr& j);
+};
+
+#endif // JOB_SCHEDULER_H
@@ -0,0 +1,79 @@
+#include "local_approximation.h"
+#include "../app_data/data_column.h"
+
+#include <algorithm>
+
+namespace
+{
+    ///Smallest margin of a local fit in data points
+    const std::size_t nMinMargin = 64;
+
+    ///Largest number of data points of a new local fit per sample of a curve
+    const std::size_t nMaxPointsPerSample = 32;
+}
+
+LocalApproximation::LocalApproximation(std::size_t nCacheSize)
+    :
+      m_nCacheSize(nCacheSize),
+      m_type(Approximator::CubicSplineType),
+      m_fSmooth(0.0)
+{}
+
+void LocalApproximation::reset(Approximator::ApproximatorType type, double fSmooth)
+{
+    m_type = type;
+    m_fSmooth = fSmooth;
+    m_fits.clear();
+}
+
+void LocalApproximation::curve(const Approximator& global, const data_column& x, const data_column& y,
+                               double fXMin, double fXMax, std::size_t nSamples, Vector& vX, Vector& vY)
+{
+    vX.resize(nSamples);
+    double dx = nSamples > 1 ? (fXMax - fXMin) / (nSamples - 1) : 0.0;
+    for(std::size_t i = 0; i < nSamples; ++i) vX[i] = fXMin + dx * i;
+
+    const Approximator* pApproximator = nullptr;
+    if(!x.empty())
+    {
+        std::size_t nFirst = x.lower_index(fXMin);
+        std::size_t nLast = std::min(x.size(), x.lower_index(fXMax) + 2);
+        pApproximator = approximator(x, y, nFirst, nLast, nSamples);
+    }
+    vY = (pApproximator ? *pApproximator : global).approximate(vX);
+}
+
+const Approximator* LocalApproximation::approximator(const data_column& x, const data_column& y,
+                                                     std::size_t nFirst, std::size_t nLast, std::size_t nSamples)
+{
+    const std::size_t N = x.size();
+
+    //Margins keep boundary effects of a fit out of view, a half of them is enough to reuse a fit
+    std::size_t nMargin = std::max((nLast - nFirst) / 2, nMinMargin);
+    std::size_t nNeedFirst = nFirst > nMargin / 2 ? nFirst - nMargin / 2 : 0;
+    std::size_t nNeedLast = std::min(N, nLast + nMargin / 2);
+    for(std::list<Fit>::iterator it = m_fits.begin(); it != m_fits.end(); ++it)
+    {
+        if(it->nFirst <= nNeedFirst && it->nLast >= nNeedLast)
+        {
+            m_fits.splice(m_fits.begin(), m_fits, it);
+            return m_fits.front().pApproximator.get();
+        }
+    }
+
+    Fit fit;
+    fit.nFirst = nFirst > nMargin ? nFirst - nMargin : 0;
+    fit.nLast = std::min(N, nLast + nMargin);
+    const std::size_t nBudget = std::max(nMaxPointsPerSample * nSamples, 4 * nMinMargin);
+    if(2 * (fit.nLast - fit.nFirst) > N || fit.nLast - fit.nFirst > nBudget) return nullptr;
+
+    Vector vXVals(x.begin() + fit.nFirst, x.begin() + fit.nLast);
+    Vector vYVals(y.begin() + fit.nFirst, y.begin() + fit.nLast);
+    CubicSplineApproximator::CubicSplineParams
+            params(vXVals, vYVals, m_fSmooth, x.is_uniform() ? x.step() : 0.0);
+    fit.pApproximator.reset(Approximator::create(m_type, params));
+
+    m_fits.push_front(fit);
+    if(m_fits.size() > m_nCacheSize) m_fits.pop_back();
+    return m_fits.front().pApproximator.get();
+}
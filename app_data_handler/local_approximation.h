@@ -0,0 +1,71 @@
+#ifndef LOCAL_APPROXIMATION_H
+#define LOCAL_APPROXIMATION_H
+
+#include <list>
+#include <memory>
+
+#include "approximator_factory.h"
+
+class data_column;
+
+/**
+ * @brief The LocalApproximation class draws an approximation of a visible x-range. Data of the range
+ * with margins are refitted separately, fits are cached by ranges of data points, so a fit covering
+ * a visible range is reused while a view is panned or zoomed in. A local fit is made on the calling thread,
+ * so ranges with more points than a budget per sample or covering most of the data are approximated
+ * by the global approximator
+ */
+class LocalApproximation
+{
+public:
+    using Vector = Approximator::Vector;
+
+    /**
+     * @param nCacheSize number of cached fits
+     */
+    LocalApproximation(std::size_t nCacheSize = 8);
+
+    /**
+     * @brief reset sets parameters of local fits and drops cached fits, it is called
+     * when data, the type of approximator or smoothing are changed
+     * @param type
+     * @param fSmooth
+     */
+    void reset(Approximator::ApproximatorType type, double fSmooth);
+
+    /**
+     * @brief curve approximates y-values at equally spaced x-values of [fXMin, fXMax]
+     * @param global approximator of all the data
+     * @param x sorted x-values of data
+     * @param y
+     * @param fXMin
+     * @param fXMax
+     * @param nSamples number of x-values, e.g. a plot width in pixels
+     * @param vX x-values of the curve
+     * @param vY y-values of the curve
+     */
+    void curve(const Approximator& global, const data_column& x, const data_column& y,
+               double fXMin, double fXMax, std::size_t nSamples, Vector& vX, Vector& vY);
+
+private:
+    struct Fit
+    {
+        std::size_t nFirst, nLast; ///<range of fitted data points
+        std::shared_ptr<const Approximator> pApproximator;
+    };
+
+    std::size_t m_nCacheSize;
+    Approximator::ApproximatorType m_type;
+    double m_fSmooth;
+    std::list<Fit> m_fits; ///<the most recently used fit goes first
+
+    /**
+     * @brief approximator finds a cached fit covering [nFirst, nLast) or fits data of the range with margins
+     * @param nSamples number of samples of the curve, it limits the number of points of a new fit
+     * @return a local approximator or null if the range is too large to be fitted locally
+     */
+    const Approximator* approximator(const data_column& x, const data_column& y,
+                                     std::size_t nFirst, std::size_t nLast, std::size_t nSamples);
+};
+
+#endif // LOCAL_APPROXIMATION_H
@@ -0,0 +1,239 @@
+#include "peak_pipeline.h"
+#include "../app_data/math/solvers.h"
+#include "../new_math/peacewisepoly.h"
+
+#include <algorithm>
+
+namespace
+{
+    /**
+     * Converts spline coefficients a + b*t + c*t^2/2 + d*t^3/6 of a piece into the layout of PeacewisePoly
+     */
+    inline void poly_coefs(double a, double b, double c, double d, double* coefs)
+    {
+        coefs[0] = d/6.;
+        coefs[1] = c/2.;
+        coefs[2] = b;
+        coefs[3] = a;
+    }
+}
+
+peak_pipeline::peak_pipeline(job_scheduler& scheduler, double smooth, size_t window, size_t overlap,
+                             result_function on_result)
+    :
+      scheduler_(scheduler),
+      smooth_(smooth),
+      window_(window),
+      overlap_(0),
+      core_(0),
+      on_result_(on_result),
+      sorted_(true),
+      base_(0),
+      size_(0),
+      cuts_(1, 0),
+      submitted_(0)
+{
+    if(overlap > 0) set_overlap_(overlap);
+}
+
+peak_pipeline::~peak_pipeline()
+{
+    for(job_scheduler::job_id job : jobs_) scheduler_.cancel(job);
+    for(job_scheduler::job_id job : jobs_) scheduler_.wait(job);
+}
+
+void peak_pipeline::push(const double* x, const double* y, size_t n)
+{
+    if(!sorted_ || n == 0) return;
+    bool ascending = size_ == 0 || x[0] > x_.back();
+    for(size_t i = 1; ascending && i < n; ++i) ascending = x[i] > x[i-1];
+    if(!ascending)
+    {
+        sorted_ = false;
+        vector().swap(x_);
+        vector().swap(y_);
+        return;
+    }
+    x_.insert(x_.end(), x, x + n);
+    y_.insert(y_.end(), y, y + n);
+    size_ += n;
+
+    if(overlap_ == 0 && size_ > 1) set_overlap_(math::spline_overlap(smooth_, (x_.back() - x_.front()) / (size_ - 1), 1.0));
+
+    //A segment is fitted when its window is loaded, and the data are known to be longer than a window
+    if(overlap_ < 2) return;
+    cut_(size_);
+    while(submitted_ + 1 < cuts_.size() && size_ >= std::max(cuts_[submitted_ + 1] + overlap_, window_ + 1))
+        submit_segment_();
+}
+
+job_scheduler::job_id peak_pipeline::finish()
+{
+    if(!sorted_) return 0;
+
+    //Short data are fitted at once, cuts of submitted segments are never dropped as the tail is long enough
+    if(submitted_ == 0 && (size_ <= window_ || overlap_ < 2)) cuts_.assign(1, 0);
+    else
+    {
+        cut_(size_);
+        if(cuts_.size() > 1 && size_ - cuts_.back() < overlap_) cuts_.pop_back();
+    }
+    cuts_.push_back(size_);
+    while(submitted_ + 1 < cuts_.size()) submit_segment_();
+
+    std::vector<std::shared_ptr<part>> parts = parts_;
+    result_function on_result = on_result_;
+    job_scheduler::job_id job = scheduler_.submit
+    (
+        job_scheduler::PEAKS_JOB,
+        [parts, on_result](job_scheduler::context&)
+        {
+            //Jobs finished before this one was submitted do not cancel it when they fail
+            for(const std::shared_ptr<part>& p : parts)
+                if(!p->done) return;
+            vector positions, intensities;
+            for(const std::shared_ptr<part>& p : parts)
+            {
+                positions.insert(positions.end(), p->positions.begin(), p->positions.end());
+                intensities.insert(intensities.end(), p->intensities.begin(), p->intensities.end());
+            }
+            if(on_result) on_result(positions, intensities);
+        },
+        jobs_
+    );
+    jobs_.push_back(job);
+    return job;
+}
+
+void peak_pipeline::set_overlap_(size_t overlap)
+{
+    overlap_ = overlap;
+    window_ = std::max(window_, 4 * overlap);
+    core_ = window_ - 2 * overlap;
+}
+
+void peak_pipeline::cut_(size_t n)
+{
+    while(n - cuts_.back() > core_) cuts_.push_back(math::spline_cut(y_.data(), base_, cuts_.back(), core_));
+}
+
+void peak_pipeline::submit_segment_()
+{
+    const size_t k = submitted_++, overlap = overlap_, N = size_;
+    const math::spline_window win(cuts_[k], cuts_[k+1], N, overlap);
+    const size_t begin = win.begin, end = win.end, own_begin = win.own_begin, own_end = win.own_end;
+    const size_t left_zone = win.left_zone, right_zone = win.right_zone;
+
+    struct window_points
+    {
+        vector x, y;
+    };
+    std::shared_ptr<window_points> points = std::make_shared<window_points>();
+    points->x.assign(x_.begin() + (begin - base_), x_.begin() + (end - base_));
+    points->y.assign(y_.begin() + (begin - base_), y_.begin() + (end - base_));
+
+    std::shared_ptr<part> own = std::make_shared<part>();
+    std::shared_ptr<zone> left = win.left ? zones_[k-1] : std::shared_ptr<zone>();
+    std::shared_ptr<zone> right = win.right ? std::make_shared<zone>() : std::shared_ptr<zone>();
+    if(right) zones_.push_back(right);
+    const double smooth = smooth_;
+
+    segment_jobs_.push_back(scheduler_.submit
+    (
+        job_scheduler::FIT_JOB,
+        [=](job_scheduler::context&)
+        {
+            const size_t n = end - begin;
+            if(n < 2)
+            {
+                own->done = true;
+                return;
+            }
+            vector a(n), b(n), c(n), d(n);
+            math::cubic_spline_fitter<double>(n, points->x.data(), points->y.data())
+                    .fit(smooth, a.data(), b.data(), c.data(), d.data());
+
+            //The last point starts no piece
+            const size_t pieces_end = std::min(own_end, N - 1);
+            if(pieces_end > own_begin)
+            {
+                vector coefs(4 * (pieces_end - own_begin));
+                for(size_t i = own_begin; i < pieces_end; ++i)
+                {
+                    const size_t j = i - begin;
+                    poly_coefs(a[j], b[j], c[j], d[j], coefs.data() + 4 * (i - own_begin));
+                }
+                PeacewisePoly::findPiecesMaxs(coefs.data(), 3, points->x.data() + (own_begin - begin),
+                                              pieces_end - own_begin, own->positions, own->intensities);
+            }
+
+            //Coefficients of blend zones are kept by coefficient, they are blended like by the segmented fit
+            const vector* abcd[] = { &a, &b, &c, &d };
+            if(left)
+            {
+                left->right.resize(4 * overlap);
+                for(size_t j = 0; j < 4; ++j)
+                    std::copy(abcd[j]->begin() + (left_zone - begin), abcd[j]->begin() + (left_zone - begin + overlap),
+                              left->right.begin() + j * overlap);
+            }
+            if(right)
+            {
+                right->left.resize(4 * overlap);
+                for(size_t j = 0; j < 4; ++j)
+                    std::copy(abcd[j]->begin() + (right_zone - begin), abcd[j]->begin() + (right_zone - begin + overlap),
+                              right->left.begin() + j * overlap);
+                right->x.assign(points->x.begin() + (right_zone - begin),
+                                points->x.begin() + (right_zone - begin + overlap + 1));
+            }
+            own->done = true;
+        }
+    ));
+    jobs_.push_back(segment_jobs_.back());
+
+    if(left)
+    {
+        std::shared_ptr<part> blended = std::make_shared<part>();
+        parts_.push_back(blended);
+        std::vector<job_scheduler::job_id> after(segment_jobs_.end() - 2, segment_jobs_.end());
+        jobs_.push_back(scheduler_.submit
+        (
+            job_scheduler::PEAKS_JOB,
+            [left, blended, overlap](job_scheduler::context&)
+            {
+                //The fit of the left window may have failed before this job was submitted
+                if(left->left.size() != 4 * overlap) return;
+                vector blend(4 * overlap);
+                const double* l[4];
+                const double* r[4];
+                double* v[4];
+                for(size_t j = 0; j < 4; ++j)
+                {
+                    l[j] = left->left.data() + j * overlap;
+                    r[j] = left->right.data() + j * overlap;
+                    v[j] = blend.data() + j * overlap;
+                }
+                math::blend_spline_pieces(overlap, left->x.data(), l, r, v);
+                vector coefs(4 * overlap);
+                for(size_t p = 0; p < overlap; ++p)
+                    poly_coefs(v[0][p], v[1][p], v[2][p], v[3][p], coefs.data() + 4 * p);
+                PeacewisePoly::findPiecesMaxs(coefs.data(), 3, left->x.data(), overlap,
+                                              blended->positions, blended->intensities);
+                blended->done = true;
+            },
+            after
+        ));
+    }
+    parts_.push_back(own);
+
+    //Points before the next window are not needed any more
+    if(win.right)
+    {
+        const size_t next_begin = cuts_[k+1] - overlap;
+        if(2 * (next_begin - base_) > x_.size())
+        {
+            x_.erase(x_.begin(), x_.begin() + (next_begin - base_));
+            y_.erase(y_.begin(), y_.begin() + (next_begin - base_));
+            base_ = next_begin;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef PEAK_PIPELINE_H
+#define PEAK_PIPELINE_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "job_scheduler.h"
+
+/**
+ * Picks peaks of a smoothing cubic spline of a spectrum while its points are being loaded. Points are cut
+ * into segments the way math::spline_segments does it, a window of a segment with overlaps is fitted by a job
+ * as soon as its points are pushed, and peaks of a blend zone around a cut are picked by a job run after fits
+ * of both neighbouring windows. So fitting and peak picking run concurrently with parsing of later blocks,
+ * peaks are the ones of the spline of math::segmented_cubic_spline_coefficients with the same window and overlap.
+ * A zero overlap is taken by math::spline_overlap for the mean step of the points of the first push
+ */
+class peak_pipeline
+{
+public:
+    using size_t = std::size_t;
+    using vector = std::vector<double>;
+
+    /**
+     * Receives positions of peaks in ascending order and values of the spline at them,
+     * it is called from a thread of a job
+     */
+    using result_function = std::function<void(const vector& positions, const vector& intensities)>;
+
+    peak_pipeline(job_scheduler& scheduler, double smooth, size_t window, size_t overlap, result_function on_result);
+
+    /**
+     * Cancels jobs and waits for running ones
+     */
+    ~peak_pipeline();
+
+    /**
+     * Appends points, x-values should ascend above the ones pushed before
+     */
+    void push(const double* x, const double* y, size_t n);
+
+    /**
+     * Submits fits of the remaining points and a job passing peaks to the result function,
+     * peaks are not passed if a job failed
+     * @return the last job or zero if x-values did not ascend and peaks are not picked
+     */
+    job_scheduler::job_id finish();
+
+    /**
+     * Number of pushed points
+     */
+    size_t size() const { return size_; }
+
+private:
+    //Peaks found by a job, a part is done when its job is finished without an error
+    struct part
+    {
+        part() : done(false) {}
+        vector positions, intensities;
+        bool done;
+    };
+
+    //Blend zone around a cut, spline coefficients of the left and the right windows and x-values of the zone
+    struct zone
+    {
+        vector left, right, x;
+    };
+
+    job_scheduler& scheduler_;
+    double smooth_;
+    size_t window_, overlap_, core_;    //core_ is set along with a nonzero overlap_
+    result_function on_result_;
+    bool sorted_;
+
+    vector x_, y_;                  //points from base_ on
+    size_t base_, size_;
+    std::vector<size_t> cuts_;      //starts of known segments
+    size_t submitted_;              //segments submitted for fitting
+    std::vector<std::shared_ptr<part>> parts_;   //parts of segments alternating with parts of zones
+    std::vector<std::shared_ptr<zone>> zones_;
+    std::vector<job_scheduler::job_id> segment_jobs_, jobs_;
+
+    /**
+     * Sets the overlap and widens the window to four overlaps like the segmented fit
+     */
+    void set_overlap_(size_t overlap);
+
+    /**
+     * Adds cuts while there are enough points beyond the last one
+     */
+    void cut_(size_t n);
+
+    /**
+     * Submits a fit of the next segment and peak picking of the blend zone before it
+     */
+    void submit_segment_();
+};
+
+#endif // PEAK_PIPELINE_H
@@ -0,0 +1,98 @@
+#include "spectra_batch.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("mass_peaks_batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Picks peaks of spectra and writes them into <spectrum>.peaks.txt tables.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("spectra", "Directories of spectra or wildcard patterns of files.",
+                                 "<dir|pattern>...");
+    QCommandLineOption approximatorOption(QStringList() << "a" << "approximator",
+        "Approximator: spline, spline-new or equal-step.", "name", "spline");
+    QCommandLineOption smoothOption(QStringList() << "s" << "smooth",
+        "Smoothing parameter of splines or 'auto' to choose it by cross validation.", "value", "1");
+    QCommandLineOption noiseOption(QStringList() << "n" << "noise",
+        "Chooses smoothing by a standard deviation of noise.", "sigma");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+        "Directory of peak tables, they are written next to spectra by default.", "dir");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+        "Number of spectra processed at once, all cores are used by default.", "count", "0");
+    QCommandLineOption windowOption(QStringList() << "w" << "window",
+        "Fits spectra longer than this number of points by overlapping windows with spline-new and equal-step, "
+        "0 fits all points at once.", "points", "0");
+    parser.addOption(approximatorOption);
+    parser.addOption(smoothOption);
+    parser.addOption(noiseOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(windowOption);
+    parser.process(a);
+
+    spectra_batch::settings settings;
+    QString approximator = parser.value(approximatorOption);
+    if(approximator == "spline") settings.fit.type = Approximator::CubicSplineType;
+    else if(approximator == "spline-new") settings.fit.type = Approximator::CubicSplineNewType;
+    else if(approximator == "equal-step") settings.fit.type = Approximator::CubicSplineEqualStepSizeType;
+    else
+    {
+        std::fprintf(stderr, "Unknown approximator: %s.\n", approximator.toLocal8Bit().constData());
+        return 2;
+    }
+
+    bool ok = true;
+    if(parser.value(smoothOption) == "auto") settings.fit.optimal_smooth = true;
+    else settings.fit.smooth = parser.value(smoothOption).toDouble(&ok);
+    if(!ok || settings.fit.smooth <= 0.0)
+    {
+        std::fprintf(stderr, "Smoothing parameter should be a positive number or 'auto'.\n");
+        return 2;
+    }
+    if(parser.isSet(noiseOption))
+    {
+        settings.fit.noise = parser.value(noiseOption).toDouble(&ok);
+        if(!ok || settings.fit.noise <= 0.0)
+        {
+            std::fprintf(stderr, "Standard deviation of noise should be a positive number.\n");
+            return 2;
+        }
+        settings.fit.optimal_smooth = true;
+    }
+    settings.threads = parser.value(threadsOption).toUInt(&ok);
+    if(!ok)
+    {
+        std::fprintf(stderr, "Number of threads should be a non-negative integer.\n");
+        return 2;
+    }
+    settings.fit.window = parser.value(windowOption).toULongLong(&ok);
+    if(!ok)
+    {
+        std::fprintf(stderr, "Window should be a non-negative number of points.\n");
+        return 2;
+    }
+    settings.output_dir = parser.value(outputOption);
+    if(!settings.output_dir.isEmpty() && !QDir().mkpath(settings.output_dir))
+    {
+        std::fprintf(stderr, "Fail to create directory: %s.\n", settings.output_dir.toLocal8Bit().constData());
+        return 2;
+    }
+
+    QStringList files;
+    for(const QString& path : parser.positionalArguments()) files << spectra_batch::find_spectra(path);
+    if(files.isEmpty())
+    {
+        std::fprintf(stderr, "No spectra are found.\n");
+        parser.showHelp(2);
+    }
+
+    spectra_batch batch(settings);
+    return batch.run(files) == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "spectra_batch.h"
+#include "../app_data_handler/job_scheduler.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <atomic>
+#include <cstdio>
+
+namespace
+{
+    const char* const peaks_suffix = ".peaks.txt";
+}
+
+spectra_batch::settings::settings()
+    :
+      threads(0)
+{}
+
+spectra_batch::spectra_batch(const settings& params)
+    :
+      settings_(params)
+{}
+
+QStringList spectra_batch::find_spectra(const QString& path)
+{
+    QFileInfo info(path);
+    QDir dir = info.isDir() ? QDir(path) : info.dir();
+    QStringList filters;
+    if(info.isDir()) filters << "*.txt" << "*.dat" << "*.csv" << "*.mps";
+    else filters << info.fileName();
+
+    QStringList files;
+    for(const QString& name : dir.entryList(filters, QDir::Files, QDir::Name))
+        if(!name.endsWith(peaks_suffix)) files << dir.filePath(name);
+    return files;
+}
+
+QString spectra_batch::peaks_file(const QString& file_name) const
+{
+    QFileInfo info(file_name);
+    QDir dir = settings_.output_dir.isEmpty() ? info.dir() : QDir(settings_.output_dir);
+    return dir.filePath(info.completeBaseName() + peaks_suffix);
+}
+
+size_t spectra_batch::run(const QStringList& files)
+{
+    //Parsing, fits and peak search of a file run their loops on math::thread_pool, which is shared by all files,
+    //so files processed at once add no threads beyond the pool. The scheduler bounds the number of spectra in memory
+    std::atomic<size_t> failed(0);
+    {
+        job_scheduler scheduler(settings_.threads);
+        for(const QString& file_name : files)
+        {
+            scheduler.submit
+            (
+                job_scheduler::LOAD_JOB,
+                [this, file_name, &failed](job_scheduler::context&)
+                {
+                    size_t peaks = 0;
+                    QString error;
+                    if(process_(file_name, peaks, error))
+                    {
+                        report_(QString("%1: %2 peaks").arg(file_name).arg(peaks), false);
+                    }
+                    else
+                    {
+                        ++failed;
+                        report_(QString("%1: %2").arg(file_name).arg(error), true);
+                    }
+                }
+            );
+        }
+        scheduler.wait_all();
+    }
+    return failed;
+}
+
+bool spectra_batch::process_(const QString& file_name, size_t& peaks, QString& error) const
+{
+    //Every spectrum is read once, so text files are parsed without binary caches
+    std::string strError;
+    Approximator::Vector positions, intensities;
+    if(!mass_peaks_core::find_peaks(QFile::encodeName(file_name).toStdString(), settings_.fit,
+                                    positions, intensities, strError))
+    {
+        error = QString::fromStdString(strError);
+        return false;
+    }
+    peaks = positions.size();
+
+    QFile file(peaks_file(file_name));
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        error = QString("Fail to write file: ") + file.fileName() + ".";
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setRealNumberPrecision(15);
+    stream << "position\tintensity\n";
+    for(size_t i = 0; i < positions.size(); ++i) stream << positions[i] << '\t' << intensities[i] << '\n';
+    stream.flush();
+    if(file.error() != QFile::NoError)
+    {
+        error = QString("Fail to write file: ") + file.fileName() + ".";
+        return false;
+    }
+    return true;
+}
+
+void spectra_batch::report_(const QString& message, bool error)
+{
+    std::lock_guard<std::mutex> lock(report_mutex_);
+    std::fprintf(error ? stderr : stdout, "%s\n", message.toLocal8Bit().constData());
+    std::fflush(error ? stderr : stdout);
+}
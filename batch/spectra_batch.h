@@ -0,0 +1,58 @@
+#ifndef SPECTRA_BATCH_H
+#define SPECTRA_BATCH_H
+
+#include <QString>
+#include <QStringList>
+
+#include <mutex>
+
+#include "../core/mass_peaks_core.h"
+
+/**
+ * Picks peaks of many spectra without a GUI. Every file is loaded, fitted and written as a peak table
+ * by its own job through the mass_peaks_core library, so files are processed in parallel
+ */
+class spectra_batch
+{
+public:
+    struct settings
+    {
+        mass_peaks_core::fit_settings fit;
+        QString output_dir;     //peak tables are written next to spectra if it is empty
+        size_t threads;         //spectra processed at once, all cores are used if it is zero
+
+        settings();
+    };
+
+    explicit spectra_batch(const settings& params);
+
+    /**
+     * Spectra in a directory or files matching a wildcard pattern, written peak tables are skipped
+     */
+    static QStringList find_spectra(const QString& path);
+
+    /**
+     * File of the peak table of a spectrum
+     */
+    QString peaks_file(const QString& file_name) const;
+
+    /**
+     * Processes files and reports them to the standard output and errors to the standard error
+     * @return number of files which failed
+     */
+    size_t run(const QStringList& files);
+
+private:
+    settings settings_;
+    std::mutex report_mutex_;
+
+    /**
+     * Loads, fits and writes peaks of a spectrum
+     * @return false with an error message if the file was not processed
+     */
+    bool process_(const QString& file_name, size_t& peaks, QString& error) const;
+
+    void report_(const QString& message, bool error);
+};
+
+#endif // SPECTRA_BATCH_H
@@ -0,0 +1,183 @@
+#include "mass_peaks_core.h"
+#include "../app_data/binary_format.h"
+#include "../app_data/text_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+namespace
+{
+    /**
+     * Reads a whole file, the buffer of a vector is aligned enough for columns of a binary file
+     */
+    bool read_file(const std::string& file_name, std::vector<char>& bytes, std::string& error)
+    {
+        std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+        if(!file)
+        {
+            error = "Fail to open file: " + file_name + ".";
+            return false;
+        }
+        bytes.resize(std::size_t(file.tellg()));
+        file.seekg(0);
+        if(!bytes.empty() && !file.read(bytes.data(), std::streamsize(bytes.size())))
+        {
+            error = "Fail to read file: " + file_name + ".";
+            return false;
+        }
+        return true;
+    }
+
+    bool load_text(const std::string& file_name, const text_parser::text_format& format, xy_data& data,
+                   std::string& error)
+    {
+        std::vector<char> bytes;
+        if(!read_file(file_name, bytes, error)) return false;
+
+        text_parser::columns cols;
+        text_parser::parse_error err = text_parser::parse_columns_parallel(bytes.data(), bytes.data() + bytes.size(),
+                                                                           format, cols);
+        if(err.type == text_parser::parse_error::TEXT_LINE)
+        {
+            error = "Text information in file: " + file_name + " on line " + std::to_string(err.line) + ".";
+            return false;
+        }
+        if(err.type == text_parser::parse_error::COLUMNS_NUMBER)
+        {
+            error = "Number of columns at line " + std::to_string(err.line) + " is "
+                    + std::to_string(err.columns) + ".";
+            return false;
+        }
+        data = xy_data();
+        data.x().swap(cols.x);
+        data.y().swap(cols.y);
+        data.w().swap(cols.w);
+        data.compact();
+        return true;
+    }
+
+    bool load_binary(const std::string& file_name, xy_data& data, std::string& error)
+    {
+        //Columns of little-endian files are views of the read bytes
+        std::shared_ptr<std::vector<char>> bytes = std::make_shared<std::vector<char>>();
+        if(!read_file(file_name, *bytes, error)) return false;
+
+        binary_format::file_header header;
+        if(!binary_format::read_header(bytes->data(), bytes->size(), header, error))
+        {
+            error += " File: " + file_name + ".";
+            return false;
+        }
+        if(!binary_format::verify_columns(bytes->data(), header))
+        {
+            error = "Binary spectrum data are corrupted. File: " + file_name + ".";
+            return false;
+        }
+
+        const std::size_t N = header.points;
+        const bool weights = header.flags & binary_format::HAS_WEIGHTS;
+        const bool uniform = header.flags & binary_format::UNIFORM_X;
+        const double* x = binary_format::column(bytes->data(), header, binary_format::X_COLUMN);
+        const double* y = binary_format::column(bytes->data(), header, binary_format::Y_COLUMN);
+        const double* w = weights ? binary_format::column(bytes->data(), header, binary_format::W_COLUMN) : nullptr;
+        if(binary_format::host_is_little_endian())
+        {
+            data = xy_data(uniform ? data_column::uniform(header.x_start, header.x_step, N) : data_column(bytes, x, N),
+                           data_column(bytes, y, N),
+                           weights ? data_column(bytes, w, N) : data_column());
+        }
+        else
+        {
+            auto swapped = [N](const double* p) -> data_vector_type
+            {
+                data_vector_type v(p, p + N);
+                for(double& val : v) std::reverse(reinterpret_cast<char*>(&val), reinterpret_cast<char*>(&val + 1));
+                return v;
+            };
+            data = xy_data(uniform ? data_column::uniform(header.x_start, header.x_step, N) : data_column(swapped(x)),
+                           data_column(swapped(y)),
+                           data_column(weights ? swapped(w) : data_vector_type()));
+        }
+        return true;
+    }
+}
+
+mass_peaks_core::fit_settings::fit_settings()
+    :
+      type(Approximator::CubicSplineType),
+      smooth(1.0),
+      optimal_smooth(false),
+      noise(0.0),
+      window(0)
+{}
+
+mass_peaks_core::file_type mass_peaks_core::spectrum_file_type(const std::string& file_name)
+{
+    std::string::size_type dot = file_name.find_last_of("./\\");
+    if(dot == std::string::npos || file_name[dot] != '.') return UNKNOWN_FILE;
+    std::string ext = file_name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(c)); });
+    if(ext == "txt" || ext == "dat") return TEXT_FILE;
+    if(ext == "csv") return CSV_FILE;
+    if(ext == "mps") return BINARY_FILE;
+    return UNKNOWN_FILE;
+}
+
+bool mass_peaks_core::load_spectrum(const std::string& file_name, xy_data& data, std::string& error)
+{
+    switch(spectrum_file_type(file_name))
+    {
+    case TEXT_FILE: return load_text(file_name, text_parser::tab_separated, data, error);
+    case CSV_FILE: return load_text(file_name, text_parser::comma_separated, data, error);
+    case BINARY_FILE: return load_binary(file_name, data, error);
+    default:
+        error = "Unknown type of file: " + file_name + ".";
+        return false;
+    }
+}
+
+std::unique_ptr<Approximator> mass_peaks_core::fit(const xy_data& data, const fit_settings& settings,
+                                                    std::string& error)
+{
+    if(data.x().size() < 4 || data.y().size() < 4)
+    {
+        error = "Too few points to fit.";
+        return std::unique_ptr<Approximator>();
+    }
+
+    //Uniform grid of x-values enables fast paths of approximators, compact columns are expanded only for the fit
+    const data_column& x = data.x();
+    const double step = x.is_uniform() ? x.step() : 0.0;
+    const Approximator::Vector vX = x.to_vector(), vY = data.y().to_vector();
+    CubicSplineApproximator::CubicSplineParams params(vX, vY, settings.smooth, step, settings.window);
+    std::unique_ptr<Approximator> approximator(Approximator::create(settings.type, params));
+    if(!approximator)
+    {
+        error = "Unknown approximator.";
+        return approximator;
+    }
+    if(settings.optimal_smooth)
+    {
+        //An approximator which can not be refitted is created again with the chosen smoothing
+        double smooth = approximator->optimalSmoothing(settings.noise);
+        if(smooth > 0.0 && !approximator->setSmoothing(smooth))
+        {
+            CubicSplineApproximator::CubicSplineParams optimal(vX, vY, smooth, step, settings.window);
+            approximator.reset(Approximator::create(settings.type, optimal));
+        }
+    }
+    return approximator;
+}
+
+bool mass_peaks_core::find_peaks(const std::string& file_name, const fit_settings& settings,
+                                 std::vector<double>& positions, std::vector<double>& intensities,
+                                 std::string& error)
+{
+    xy_data data;
+    if(!load_spectrum(file_name, data, error)) return false;
+    std::unique_ptr<Approximator> approximator = fit(data, settings, error);
+    if(!approximator) return false;
+    approximator->findPeaks(positions, intensities);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef MASS_PEAKS_CORE_H
+#define MASS_PEAKS_CORE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../app_data/app_data.h"
+#include "../app_data_handler/approximator_factory.h"
+
+/**
+ * Qt-free interface of the mass_peaks_core library: loading, fitting and peak picking of spectra.
+ * Functions return false and set error on failure like the ones of binary_format
+ */
+namespace mass_peaks_core
+{
+    enum file_type
+    {
+        TEXT_FILE = 0x00,   ///tab separated text, *.txt and *.dat
+        CSV_FILE = 0x01,    ///comma separated text, *.csv
+        BINARY_FILE = 0x02, ///native binary spectrum, *.mps
+        UNKNOWN_FILE = 0xFF
+    };
+
+    struct fit_settings
+    {
+        Approximator::ApproximatorType type;
+        double smooth;          ///smoothing parameter of splines
+        bool optimal_smooth;    ///smoothing is chosen for the data by noise or by cross validation
+        double noise;           ///standard deviation of noise, if it is not positive cross validation is used
+        std::size_t window;     ///longer spectra are fitted by overlapping windows, zero fits all points at once
+
+        fit_settings();
+    };
+
+    /**
+     * Type of a spectrum file by its extension
+     */
+    file_type spectrum_file_type(const std::string& file_name);
+
+    /**
+     * Loads a spectrum file. Text is parsed on all cores, binary columns are used right from the read file
+     */
+    bool load_spectrum(const std::string& file_name, xy_data& data, std::string& error);
+
+    /**
+     * Fits a spline to the data, null with an error if it can not be fitted
+     */
+    std::unique_ptr<Approximator> fit(const xy_data& data, const fit_settings& settings, std::string& error);
+
+    /**
+     * Loads a spectrum, fits it and picks its peaks together with approximated values at them
+     */
+    bool find_peaks(const std::string& file_name, const fit_settings& settings,
+                    std::vector<double>& positions, std::vector<double>& intensities, std::string& error);
+}
+
+#endif // MASS_PEAKS_CORE_H
@@ -1,8 +1,10 @@
 #include <QHBoxLayout>
 #include <QToolBar>
 #include <QAction>
+#include <algorithm>
 
 #include "../app_data/app_data.h"
+#include "../app_data/minmax_pyramid.h"
 #include "zoom_plot.h"
 #include "qcustomplot/qcustomplot.h"
 
@@ -11,7 +13,9 @@ zoom_plot::zoom_plot(QWidget *parent)
       QCustomPlot(parent),
       plot_action_(NO_ACTION),
       selection_area_(new QRubberBand(QRubberBand::Rectangle, this))
-{}
+{
+    connect(this->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(update_decimated_data()));
+}
 
 zoom_plot::~zoom_plot(){}
 
@@ -73,6 +77,37 @@ void zoom_plot::mouseMoveEvent(QMouseEvent *event)
     }
 }
 
+void zoom_plot::set_decimated_data(QSharedPointer<const xy_data> data, QSharedPointer<const minmax_pyramid> pyramid)
+{
+    this->data_ = data;
+    this->pyramid_ = pyramid;
+    if(this->data_ && this->pyramid_ && this->graphCount() == 0) this->addGraph();
+    this->update_decimated_data();
+}
+
+void zoom_plot::update_decimated_data()
+{
+    if(!this->data_ || !this->pyramid_ || this->pyramid_->size() == 0 || this->graphCount() == 0) return;
+    const data_column& x = this->data_->x();
+    const data_column& y = this->data_->y();
+    const minmax_pyramid& pyramid = *this->pyramid_;
+
+    QCPRange range = this->xAxis->range();
+    size_t begin = x.lower_index(range.lower);
+    size_t end = std::min(pyramid.size(), x.lower_index(range.upper) + 2);
+    std::vector<double> xs, ys;
+    pyramid.decimate(x, y, begin, end, size_t(qMax(1, this->xAxis->axisRect()->width())), xs, ys);
+
+    QVector<QCPGraphData> points(int(xs.size()));
+    for(int i = 0; i < points.size(); ++i) points[i] = QCPGraphData(xs[i], ys[i]);
+
+    //Ends and global extremes out of view keep bounds of the data for rescaling of axes
+    const size_t bounds[] = { 0, pyramid.min_index(), pyramid.max_index(), pyramid.size() - 1 };
+    for(size_t idx : bounds)
+        if(idx < begin || idx >= end) points.append(QCPGraphData(x[idx], y[idx]));
+    this->graph(0)->data()->set(points);
+}
+
 void zoom_plot::set_hzoom(bool hzoom)
 {
     if(hzoom) this->set_plot_action(HZOOM_IN);
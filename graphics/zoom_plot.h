@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+class minmax_pyramid;
 class xy_data;
 
 /**
@@ -32,6 +33,12 @@ public:
     void mouseReleaseEvent(QMouseEvent*);
     void mouseMoveEvent(QMouseEvent* event);
 
+    /**
+     * Plots data by the first graph. On every change of the x-range the graph gets only
+     * about two points per pixel from the min/max pyramid of the data, null data stop updates
+     */
+    void set_decimated_data(QSharedPointer<const xy_data> data, QSharedPointer<const minmax_pyramid> pyramid);
+
 Q_SIGNALS:
     /**
      * Change toolbar buttons states
@@ -59,6 +66,11 @@ private Q_SLOTS:
      */
     void set_plot_action(CURRENT_PLOT_ACTION action);
 
+    /**
+     * Fills the first graph with decimated data of the current x-range
+     */
+    void update_decimated_data();
+
 private:
     /**
      * Sets the selection area view on a screen
@@ -86,6 +98,12 @@ private:
      */
     QPoint mouse_press_position_;
     QScopedPointer<QRubberBand> selection_area_;
+
+    /**
+     * Data plotted by decimation
+     */
+    QSharedPointer<const xy_data> data_;
+    QSharedPointer<const minmax_pyramid> pyramid_;
 };
 
 /**
@@ -2,18 +2,25 @@
 #include "ui_mainwindow.h"
 #include "graphics/zoom_plot.h"
 #include "app_data/app_data.h"
+#include "app_data/minmax_pyramid.h"
 #include "app_data_handler/app_data_handler.h"
 #include "app_data_handler/approximator_factory.h"
+#include "app_data_handler/approximation_worker.h"
+#include "app_data_handler/local_approximation.h"
 #include "xy_data_view.h"
 
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QComboBox>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     app_data_(new app_data_handler(this)),
-    app_data_view_(new zoom_plot_window(this))
+    app_data_view_(new zoom_plot_window(this)),
+    m_pLocalApproximation(new LocalApproximation),
+    m_pApproximationWorker(new ApproximationWorker(app_data_->scheduler(), this)),
+    m_comboChooseApproximator(Q_NULLPTR)
 {
     //Set standard widgets
     ui->setupUi(this);
@@ -24,6 +31,13 @@ MainWindow::MainWindow(QWidget *parent) :
 
     this->connect_data_handler_();
     this->create_data_view_();
+    connect(m_pApproximationWorker,
+            SIGNAL(fitted(quint64,QSharedPointer<const Approximator>,double)),
+            this, SLOT(updateApproximation(quint64,QSharedPointer<const Approximator>,double)));
+    connect(m_pApproximationWorker, SIGNAL(peaksFound(quint64,QVector<double>,QVector<double>)),
+            this, SLOT(showPeaks(quint64,QVector<double>,QVector<double>)));
+    connect(m_pApproximationWorker, SIGNAL(smoothingChosen(quint64,double)),
+            this, SLOT(setChosenSmoothing(quint64,double)));
 
     //Set plot fonts
     app_data_view_->plot_area()->xAxis->setTickLabelFont(QFont("Times", 14));
@@ -36,6 +50,8 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    //Jobs of the worker are finished while the scheduler of the data handler is alive
+    delete m_pApproximationWorker;
     delete ui;
 }
 
@@ -47,10 +63,27 @@ void MainWindow::open_file_action()
                 "Open file dialog",
                 QString(),
                 "ASCII data files (*.txt *.dat);; "
-                "CSV data files (*.csv);;All files (*.*)");
+                "CSV data files (*.csv);; "
+                "Binary spectrum files (*.mps);;All files (*.*)");
 
-    if(!file_name.isEmpty()) app_data_->load_data(file_name);
-    connect(app_data_, SIGNAL(finished()), this, SLOT(initApproximator()));
+    if(file_name.isEmpty()) return;
+
+    //Before a spectrum is fitted the smoothing is the lower bound the spin box starts with
+    double smooth = m_comboChooseApproximator ? m_spinBoxSmoothVal->value() : 1.0E-10;
+    app_data_->set_pipeline(ui->pipeline_action->isChecked(), smooth);
+    app_data_->load_data(file_name);
+}
+
+void MainWindow::save_file_action()
+{
+    QString file_name = QFileDialog::getSaveFileName
+            (
+                this,
+                "Save file dialog",
+                QString(),
+                "Binary spectrum files (*.mps)");
+
+    if(!file_name.isEmpty()) app_data_->save_data(file_name);
 }
 
 void MainWindow::show_message(QString msg)
@@ -60,6 +93,8 @@ void MainWindow::show_message(QString msg)
 
 void MainWindow::plot_data(const vector_data_type& x, const vector_data_type& y, bool keep_data_flag)
 {
+    app_data_view_->plot_area()->set_decimated_data(QSharedPointer<const xy_data>(),
+                                                     QSharedPointer<const minmax_pyramid>());
     if(!keep_data_flag) app_data_view_->plot_area()->clearGraphs();
     app_data_view_->plot_area()->addGraph()->addData(x,y);
     app_data_view_->plot_area()->rescaleAxes();
@@ -68,89 +103,131 @@ void MainWindow::plot_data(const vector_data_type& x, const vector_data_type& y,
 
 void MainWindow::plot_data(bool keep_data_flag)
 {
-    vector_data_type
-            x = vector_data_type::fromStdVector(app_data_->data().x()),
-            y = vector_data_type::fromStdVector(app_data_->data().y());
-    this->plot_data(x,y,keep_data_flag);
+    //Only points of the visible range decimated to the plot width are copied into the graph
+    if(!keep_data_flag) app_data_view_->plot_area()->clearGraphs();
+    app_data_view_->plot_area()->set_decimated_data(app_data_->data_ptr(), app_data_->pyramid());
+    app_data_view_->plot_area()->rescaleAxes();
+    app_data_view_->plot_area()->replot();
+}
+
+void MainWindow::append_data(const vector_data_type &x, const vector_data_type &y)
+{
+    if(app_data_view_->plot_area()->graphCount() == 0) app_data_view_->plot_area()->addGraph();
+    app_data_view_->plot_area()->graph(0)->addData(x, y, true);
+    app_data_view_->plot_area()->rescaleAxes();
+    app_data_view_->plot_area()->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void MainWindow::set_streaming(bool streaming)
+{
+    app_data_->set_streaming(streaming);
 }
 
-void MainWindow::changeSmoothing(double smoothing)
+void MainWindow::changeSmoothing(double)
 {
+    //The same data is refitted, so the worker reuses prepared spline equations
     changeApproximator(m_comboChooseApproximator->currentText());
 }
 
+void MainWindow::autoSmoothing()
+{
+    applyOptimalSmoothing(0.0);
+}
+
+void MainWindow::noiseSmoothing()
+{
+    bool ok = false;
+    double fNoise = QInputDialog::getDouble(this, "Smoothing by noise level",
+                                            "Standard deviation of noise:", 1.0, 0.0, 1.0E10, 10, &ok);
+    if(ok && fNoise > 0.0) applyOptimalSmoothing(fNoise);
+}
+
+void MainWindow::applyOptimalSmoothing(double fNoise)
+{
+    //Smoothing is chosen in background, it may take as long as a fit
+    if(m_pDataApproximator) m_pApproximationWorker->chooseSmoothing(fNoise);
+}
+
+void MainWindow::setChosenSmoothing(quint64 nGeneration, double fSmooth)
+{
+    //Changed value of the spin box refits the approximator
+    if(nGeneration != m_pApproximationWorker->generation()) return;
+    if(fSmooth > 0.0) m_spinBoxSmoothVal->setValue(fSmooth);
+}
+
 void MainWindow::changeApproximator(QString name)
 {
-    double fSmooth = m_spinBoxSmoothVal->text().toDouble();
-    if (name == "Cubic spline")
-    {
-        CubicSplineApproximator::CubicSplineParams
-                params(app_data_->data().x(), app_data_->data().y(), fSmooth);
-        m_pDataApproximator.reset(Approximator::create(Approximator::CubicSplineType, params));
-    }
-    else if (name == "Cubic spline (new)")
-    {
-        CubicSplineApproximator::CubicSplineParams
-                params(app_data_->data().x(), app_data_->data().y(), fSmooth);
-        m_pDataApproximator.reset(Approximator::create(Approximator::CubicSplineNewType, params));
-    }
+    Approximator::ApproximatorType type = Approximator::CubicSplineType;
+    if (name == "Cubic spline (new)")
+        type = Approximator::CubicSplineNewType;
     else if (name == "Cubic spline with equal steps")
-    {
-        CubicSplineApproximator::CubicSplineParams
-                params(app_data_->data().x(), app_data_->data().y(), fSmooth);
-        m_pDataApproximator.reset
-        (
-            Approximator::create(Approximator::CubicSplineEqualStepSizeType, params)
-        );
-    }
-    calculateCurrentStd();
+        type = Approximator::CubicSplineEqualStepSizeType;
+
+    //A newer request supersedes fits in flight, so dragging of smoothing does not queue refits
+    m_pApproximationWorker->fit(app_data_->data_ptr(), type, m_spinBoxSmoothVal->value());
+}
+
+void MainWindow::updateApproximation(quint64 nGeneration, QSharedPointer<const Approximator> pApproximator,
+                                     double fStd)
+{
+    if(nGeneration != m_pApproximationWorker->generation()) return;
+    m_pDataApproximator = pApproximator;
+    m_pLocalApproximation->reset(m_pDataApproximator->type(), m_spinBoxSmoothVal->value());
+    Q_EMIT splineStdChanged(QString(" std = %1").arg(fStd));
     Q_EMIT approximatorChanged();
 }
 
 void MainWindow::showApproxLine()
 {
+    if(!m_pDataApproximator) return;
+
+    //Zoomed views are refitted locally, the curve gets a point for every pixel
     QCPRange range = app_data_view_->plot_area()->xAxis->range();
-    double xmin = range.lower, xmax = range.upper, dx = (xmax-xmin) / 100;
-    QVector<double> x(100), y;
-    std::for_each(x.begin(), x.end(), [&xmin, dx](double& xval){ xval = (xmin+=dx);});
-    y = QVector<double>::fromStdVector(m_pDataApproximator->approximate(x.toStdVector()));
+    int nWidth = app_data_view_->plot_area()->xAxis->axisRect()->width();
+    Approximator::Vector vX, vY;
+    m_pLocalApproximation->curve(*m_pDataApproximator, app_data_->data().x(), app_data_->data().y(),
+                                 range.lower, range.upper, std::size_t(qMax(2, nWidth)), vX, vY);
+    QVector<QCPGraphData> points(int(vX.size()));
+    for(int i = 0; i < points.size(); ++i) points[i] = QCPGraphData(vX[i], vY[i]);
     QCPGraph* g;
     if(app_data_view_->plot_area()->graphCount() == 2)
         g = app_data_view_->plot_area()->graph();
     else
         g = app_data_view_->plot_area()->addGraph();
-    g->setData(x,y,true);
+    g->data()->set(points, true);
     g->setPen(QPen(Qt::red));
     app_data_view_->plot_area()->replot();
 }
 
 void MainWindow::calculatePeaks()
 {
-    if(!this->app_data_->data().x().empty())
-    {
-        QVector<double> peak_positions   =
-                QVector<double>::fromStdVector(m_pDataApproximator->getPeaks());
-        QVector<double> peak_intensities =
-                QVector<double>::fromStdVector(m_pDataApproximator->approximate(peak_positions.toStdVector()));
+    if(m_pDataApproximator) m_pApproximationWorker->findPeaks();
+}
 
-        XyDataTableView* peaksTable = new MassPeaksTable(this);
+void MainWindow::showPeaks(quint64, QVector<double> vPositions, QVector<double> vIntensities)
+{
+    XyDataTableView* peaksTable = new MassPeaksTable(this);
 
-        peaksTable->setXyData(peak_positions, peak_intensities);
+    peaksTable->setXyData(vPositions, vIntensities);
 
-        this->ui->tableView->setModel(peaksTable);
-        this->ui->tableView->update();
-    }
+    this->ui->tableView->setModel(peaksTable);
+    this->ui->tableView->update();
 }
 
 void MainWindow::connect_data_handler_()
 {
     connect(ui->open_file_action, SIGNAL(triggered()), this, SLOT(open_file_action()));
+    connect(ui->save_file_action, SIGNAL(triggered()), this, SLOT(save_file_action()));
+    connect(ui->streaming_action, SIGNAL(toggled(bool)), this, SLOT(set_streaming(bool)));
+    app_data_->set_streaming(ui->streaming_action->isChecked());
     connect(this->app_data_, SIGNAL(started()), ui->progressBar, SLOT(show()));
     connect(this->app_data_, SIGNAL(finished()), ui->progressBar, SLOT(hide()));
     connect(this->app_data_, SIGNAL(progress_val(int)), ui->progressBar, SLOT(setValue(int)));
     connect(this->app_data_, SIGNAL(busy(bool)), ui->open_file_action, SLOT(setDisabled(bool)));
     connect(this->app_data_, SIGNAL(free(bool)), ui->open_file_action, SLOT(setEnabled(bool)));
     connect(this->app_data_, SIGNAL(warning(QString)), this, SLOT(show_message(QString)));
+    connect(this->app_data_, SIGNAL(peaks_found(quint64,QVector<double>,QVector<double>)),
+            this, SLOT(showPeaks(quint64,QVector<double>,QVector<double>)));
 }
 
 void MainWindow::create_data_view_()
@@ -158,14 +235,18 @@ void MainWindow::create_data_view_()
     this->setCentralWidget(this->app_data_view_);
     connect(this->app_data_, SIGNAL(data_changed(vector_data_type,vector_data_type)),
             this, SLOT(plot_data(vector_data_type,vector_data_type)));
+    connect(this->app_data_, SIGNAL(dataChanged()), this, SLOT(plot_data()));
+    connect(this->app_data_, SIGNAL(dataChanged()), this, SLOT(initApproximator()));
+    connect(this->app_data_, SIGNAL(data_appended(vector_data_type,vector_data_type)),
+            this, SLOT(append_data(vector_data_type,vector_data_type)));
     connect(ui->actionPeaks, SIGNAL(triggered()), this, SLOT(calculatePeaks()));
 }
 
 void MainWindow::initApproximator()
 {
-    disconnect(app_data_, SIGNAL(finished()), this, SLOT(initApproximator()));
-
-    if(!m_pDataApproximator)
+    //An approximation of previous data is not shown with new data
+    m_pDataApproximator.reset();
+    if(!m_comboChooseApproximator)
     {
         //Create approximator chooser
         m_comboChooseApproximator = new QComboBox(this);
@@ -185,6 +266,14 @@ void MainWindow::initApproximator()
         connect(m_spinBoxSmoothVal, SIGNAL(valueChanged(double)),
                 this, SLOT(changeSmoothing(double)));
 
+        //Automatic choice of the smoothing parameter
+        QAction* autoSmoothingAction = ui->mainToolBar->addAction("Auto");
+        autoSmoothingAction->setToolTip("Choose smoothing by generalised cross validation");
+        connect(autoSmoothingAction, SIGNAL(triggered()), this, SLOT(autoSmoothing()));
+        QAction* noiseSmoothingAction = ui->mainToolBar->addAction("Noise...");
+        noiseSmoothingAction->setToolTip("Choose smoothing by a noise level of the data");
+        connect(noiseSmoothingAction, SIGNAL(triggered()), this, SLOT(noiseSmoothing()));
+
         //Spline standars deviation from an experimental data
         m_labelShowStd = new QLabel(" std = 0.0", this);
         ui->mainToolBar->addWidget(m_labelShowStd);
@@ -196,36 +285,6 @@ void MainWindow::initApproximator()
         connect(app_data_view_->plot_area(), SIGNAL(xrangeNotify()),
                 this, SLOT(showApproxLine()));
 
-        changeApproximator("Cubic spline");
-        showApproxLine();
-    }
-}
-
-void MainWindow::calculateCurrentStd()
-{
-    double yy = 0.0, yy2 = 0.0, norm = 0.0;
-    QVector<double> y = QVector<double>::fromStdVector(app_data_->data().y());
-    QVector<double> x = QVector<double>::fromStdVector(app_data_->data().x());
-    QVector<double> w = QVector<double>::fromStdVector(app_data_->data().w());
-    QVector<double> yt =
-            QVector<double>::fromStdVector(m_pDataApproximator->approximate(x.toStdVector()));
-    if(w.empty())
-    {
-        QVector<double>::const_iterator it1 = y.constBegin(), it2 = yt.constBegin();
-        for(; it1 != y.constEnd(); ++it1, ++it2)
-        {
-            yy += (*it1 - *it2); yy2 += (*it1 - *it2) * (*it1 - *it2);
-        }
-        norm = double(y.size());
     }
-    else
-    {
-        QVector<double>::const_iterator it1 = y.constBegin(), it2 = yt.constBegin(), it3 = w.constBegin();
-        for(; it1 != y.constEnd(); ++it1, ++it2, ++it3)
-        {
-            yy += *it3 * (*it1 - *it2); yy2 += *it3 * (*it1 - *it2) * (*it1 - *it2);
-            norm += *it3;
-        }
-    }
-    Q_EMIT splineStdChanged(QString(" std = %1").arg((yy2 - yy*yy)/norm));
+    changeApproximator(m_comboChooseApproximator->currentText());
 }
@@ -2,8 +2,11 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QSharedPointer>
 
 class Approximator;
+class ApproximationWorker;
+class LocalApproximation;
 class QCPRange;
 class app_data_handler;
 class zoom_plot_window;
@@ -25,29 +28,53 @@ public:
     ~MainWindow();
 
     Q_SLOT void open_file_action();
+    Q_SLOT void save_file_action();
     Q_SLOT void show_message(QString msg);
     Q_SLOT void plot_data(const vector_data_type &x, const vector_data_type &y, bool keep_data_flag = false);
     Q_SLOT void plot_data(bool keep_data_flag = false);
+    Q_SLOT void append_data(const vector_data_type& x, const vector_data_type& y);
+    Q_SLOT void set_streaming(bool streaming);
 
     //Approximator management
     Q_SLOT void changeSmoothing(double smoothing);
+
+    /**
+     * Requests a fit of an approximator in background
+     */
     Q_SLOT void changeApproximator(QString name);
 
     /**
-     * Shows approximatin curve
+     * Chooses smoothing by generalised cross validation
+     */
+    Q_SLOT void autoSmoothing();
+
+    /**
+     * Chooses smoothing by a noise level asked from a user
+     */
+    Q_SLOT void noiseSmoothing();
+
+    /**
+     * Shows approximatin curve of the visible x-range sampled at the plot width
      */
     Q_SLOT void showApproxLine();
 
     /**
-     * Shows peaks parameters
+     * Requests peaks of the approximation
      */
     Q_SLOT void calculatePeaks();
 
+    /**
+     * Shows peaks parameters
+     */
+    Q_SLOT void showPeaks(quint64 nGeneration, QVector<double> vPositions, QVector<double> vIntensities);
+
 private:
     Ui::MainWindow *ui;
     app_data_handler* app_data_;
     zoom_plot_window* app_data_view_;
-    QScopedPointer<Approximator> m_pDataApproximator;
+    QSharedPointer<const Approximator> m_pDataApproximator;
+    QScopedPointer<LocalApproximation> m_pLocalApproximation;
+    ApproximationWorker* m_pApproximationWorker;
 
     QComboBox * m_comboChooseApproximator;
     QDoubleSpinBox * m_spinBoxSmoothVal;
@@ -57,7 +84,21 @@ private:
     void create_data_view_();
     Q_SLOT void initApproximator();
 
-    void calculateCurrentStd();
+    /**
+     * Shows deviation and curve of a fitted approximation if it is of the latest request
+     */
+    Q_SLOT void updateApproximation(quint64 nGeneration, QSharedPointer<const Approximator> pApproximator,
+                                    double fStd);
+
+    /**
+     * Requests smoothing chosen by the approximator for a noise level or by cross validation if it is zero
+     */
+    void applyOptimalSmoothing(double fNoise);
+
+    /**
+     * Sets chosen smoothing if it is chosen by the approximation of the latest request
+     */
+    Q_SLOT void setChosenSmoothing(quint64 nGeneration, double fSmooth);
     Q_SIGNAL void splineStdChanged(QString msg);
     Q_SIGNAL void approximatorChanged();
 };
@@ -10,6 +10,7 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
 
 TARGET = mass_peaks
 TEMPLATE = app
+CONFIG += thread
 
 QMAKE_CXXFLAGS += -std=c++0x
 
@@ -18,23 +19,45 @@ SOURCES += main.cpp\
     graphics/qcustomplot/qcustomplot.cpp \
     graphics/zoom_plot.cpp \
     app_data/data_export.cpp \
+    app_data/text_parser.cpp \
+    app_data/binary_format.cpp \
+    app_data/data_column.cpp \
+    app_data/minmax_pyramid.cpp \
     app_data_handler/app_data_handler.cpp \
     app_data_handler/approximator_factory.cpp \
+    app_data_handler/approximation_worker.cpp \
+    app_data_handler/job_scheduler.cpp \
+    app_data_handler/peak_pipeline.cpp \
+    app_data_handler/local_approximation.cpp \
     xy_data_view.cpp \
-    new_math/peacewisepoly.cpp
+    new_math/peacewisepoly.cpp \
+    new_math/polykernels.cpp
 
 HEADERS  += mainwindow.h \
     graphics/qcustomplot/qcustomplot.h \
     graphics/zoom_plot.h \
     app_data/app_data.h \
+    app_data/data_column.h \
+    app_data/minmax_pyramid.h \
     app_data/data_export.h \
+    app_data/text_parser.h \
+    app_data/binary_format.h \
+    app_data/spsc_queue.h \
     app_data_handler/app_data_handler.h \
     app_data/math/solvers.h \
     app_data/math/spline.h \
     app_data/math/array_operations.h \
+    app_data/math/piece_max.h \
+    app_data/math/thread_pool.h \
+    app_data/math/uniform_grid.h \
     app_data_handler/approximator_factory.h \
+    app_data_handler/approximation_worker.h \
+    app_data_handler/job_scheduler.h \
+    app_data_handler/peak_pipeline.h \
+    app_data_handler/local_approximation.h \
     xy_data_view.h \
-    new_math/peacewisepoly.h
+    new_math/peacewisepoly.h \
+    new_math/polykernels.h
 
 FORMS    += mainwindow.ui
 
@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# Console tool picking peaks of many spectra without a GUI
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = mass_peaks_batch
+TEMPLATE = app
+CONFIG += console thread
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+#The core library is built by mass_peaks_core.pro, into the same build directory by default
+isEmpty(CORE_LIB_DIR): CORE_LIB_DIR = $$OUT_PWD
+LIBS += -L$$CORE_LIB_DIR -lmass_peaks_core
+!core_shared: PRE_TARGETDEPS += $$CORE_LIB_DIR/libmass_peaks_core.a
+
+include(mass_peaks_core.pri)
+
+SOURCES += batch/main.cpp \
+    batch/spectra_batch.cpp \
+    app_data_handler/job_scheduler.cpp
+
+HEADERS  += batch/spectra_batch.h \
+    core/mass_peaks_core.h \
+    app_data/app_data.h \
+    app_data/data_column.h \
+    app_data_handler/approximator_factory.h \
+    app_data_handler/job_scheduler.h \
+    new_math/peacewisepoly.h
@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Code generation of the core library. Its objects are compiled again by LTO
+# when a target is linked, so targets linking it share these options.
+# Other CPUs are targeted by e.g. qmake CORE_MARCH=x86-64-v3
+#
+#-------------------------------------------------
+
+isEmpty(CORE_MARCH): CORE_MARCH = native
+
+CONFIG += ltcg
+
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3 -march=$$CORE_MARCH
+QMAKE_LFLAGS_RELEASE += -O3 -march=$$CORE_MARCH
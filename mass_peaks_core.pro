@@ -0,0 +1,49 @@
+#-------------------------------------------------
+#
+# Qt-free library of loading, fitting and peak picking of spectra,
+# qmake CONFIG+=core_shared builds it as a shared library
+#
+#-------------------------------------------------
+
+CONFIG -= qt
+CONFIG += release thread
+
+TARGET = mass_peaks_core
+TEMPLATE = lib
+core_shared {
+    CONFIG += shared
+} else {
+    #Static objects keep machine code, so the library links into targets built without LTO as well
+    CONFIG += staticlib fat-static-lto
+}
+
+#Targets built in the same directory do not overwrite the makefile and objects of the library
+MAKEFILE = Makefile.core
+OBJECTS_DIR = core_obj
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+include(mass_peaks_core.pri)
+
+SOURCES += core/mass_peaks_core.cpp \
+    app_data/text_parser.cpp \
+    app_data/binary_format.cpp \
+    app_data/data_column.cpp \
+    app_data_handler/approximator_factory.cpp \
+    new_math/peacewisepoly.cpp \
+    new_math/polykernels.cpp
+
+HEADERS  += core/mass_peaks_core.h \
+    app_data/app_data.h \
+    app_data/data_column.h \
+    app_data/text_parser.h \
+    app_data/binary_format.h \
+    app_data/math/solvers.h \
+    app_data/math/spline.h \
+    app_data/math/array_operations.h \
+    app_data/math/piece_max.h \
+    app_data/math/thread_pool.h \
+    app_data/math/uniform_grid.h \
+    app_data_handler/approximator_factory.h \
+    new_math/peacewisepoly.h \
+    new_math/polykernels.h
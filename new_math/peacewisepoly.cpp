@@ -1,8 +1,15 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <map>
 
 #include "peacewisepoly.h"
+#include "polykernels.h"
 #include "app_data/math/solvers.h"
+#include "app_data/math/array_operations.h"
+#include "app_data/math/piece_max.h"
+#include "app_data/math/thread_pool.h"
+#include "app_data/math/uniform_grid.h"
 
 PeacewisePoly::PeacewisePoly(uint8_t nDegree, size_t nCoefsSize)
     :
@@ -28,6 +35,94 @@ void PeacewisePoly::diff()
     m_nDegree--;
 }
 
+void PeacewisePoly::operator()(const double* pX, double* pY, size_t n) const
+{
+    if(m_vCoefs.empty())
+    {
+        std::fill(pY, pY + n, 0.0);
+        return;
+    }
+    //Values are processed by blocks, so intervals stay in the cache for the kernel
+    const size_t nBlock = 512;
+    size_t vIdx[nBlock];
+    double vDx[nBlock];
+    for(size_t i = 0; i < n; i += nBlock)
+    {
+        size_t nCount = std::min(nBlock, n - i);
+        findIntervals(pX + i, nCount, vIdx, vDx);
+        poly_kernels::horner(m_vCoefs.data(), m_nDegree, vIdx, vDx, pY + i, nCount);
+    }
+}
+
+PeacewisePoly::Vector PeacewisePoly::operator()(const Vector& vXVals) const
+{
+    Vector vYVals(vXVals.size());
+    (*this)(vXVals.data(), vYVals.data(), vXVals.size());
+    return vYVals;
+}
+
+void PeacewisePoly::findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        pIdx[i] = findInterval(pX[i]);
+        pDx[i] = findDxValue(pX[i], pIdx[i]);
+    }
+}
+
+void PeacewisePoly::findMaxs(Vector& vXVals, Vector& vYVals) const
+{
+    vXVals.clear();
+    vYVals.clear();
+    if(m_nDegree < 2 || m_nDegree > 3 || nSteps() < 2) return;
+
+    //Large polynomials are split between threads of the pool, every chunk takes intervals by blocks
+    math::thread_pool& pool = math::thread_pool::instance();
+    const size_t nPieces = nSteps() - 1;
+    const size_t nChunks = pool.chunks(nPieces, 1 << 16);
+    std::vector<Vector> vChunksX(nChunks), vChunksY(nChunks);
+    pool.for_chunks(nPieces, nChunks, [this, &vChunksX, &vChunksY](size_t i, size_t nFirst, size_t nLast)
+    {
+        const size_t nBlock = 512;
+        double vStarts[nBlock + 1];
+        for(size_t idx = nFirst; idx < nLast; idx += nBlock)
+        {
+            size_t nCount = std::min(nBlock, nLast - idx);
+            intervalStarts(idx, nCount + 1, vStarts);
+            findPiecesMaxs(m_vCoefs.data() + idx * (m_nDegree + 1), m_nDegree, vStarts, nCount,
+                           vChunksX[i], vChunksY[i]);
+        }
+    });
+
+    vXVals = std::move(vChunksX[0]);
+    vYVals = std::move(vChunksY[0]);
+    for(size_t i = 1; i < nChunks; ++i)
+    {
+        vXVals.insert(vXVals.end(), vChunksX[i].begin(), vChunksX[i].end());
+        vYVals.insert(vYVals.end(), vChunksY[i].begin(), vChunksY[i].end());
+    }
+}
+
+void PeacewisePoly::findPiecesMaxs(const double* pCoefs, uint8_t nDegree, const double* pStarts, size_t n,
+                                   Vector& vXVals, Vector& vYVals)
+{
+    if(nDegree < 2 || nDegree > 3) return;
+    const size_t nStride = nDegree + 1;
+    double t;
+    for(size_t i = 0; i < n; ++i)
+    {
+        //Coefficients go from the highest power, a quadratic has no cubic one
+        const double* c = pCoefs + i * nStride;
+        const double a = nDegree == 3 ? c[0] : 0.0;
+        if(!math::piece_max(a, c[nDegree - 2], c[nDegree - 1], pStarts[i+1] - pStarts[i], t)) continue;
+
+        double y = c[0];
+        for(unsigned k = 1; k <= nDegree; ++k) y = y * t + c[k];
+        vXVals.push_back(pStarts[i] + t);
+        vYVals.push_back(y);
+    }
+}
+
 PeacewisePoly::PeaceCoefs PeacewisePoly::intervalCoefs(size_t idx) const
 {
     return std::make_pair(m_vCoefs.cbegin() + idx * (m_nDegree + 1),
@@ -37,7 +132,8 @@ PeacewisePoly::PeaceCoefs PeacewisePoly::intervalCoefs(size_t idx) const
 StandartPeacewisePoly::StandartPeacewisePoly(const Vector &xVals, const Vector &yVals, double fSmoothParam)
     :
       PeacewisePoly(3, xVals.size()),
-      m_xVals(xVals.size())
+      m_xVals(xVals.size()),
+      m_fStep(0.0)
 {
     assert(xVals.size() == yVals.size());
     //Check data sorting or do data sort whatever
@@ -52,21 +148,40 @@ StandartPeacewisePoly::StandartPeacewisePoly(const Vector &xVals, const Vector &
         tempYVals[i++]= xy.second;
     }
 
-    Vector  w(xVals.size(), fSmoothParam),
-            a(xVals.size()),
-            b(xVals.size()),
-            c(xVals.size()),
-            d(xVals.size());
-    math::cubic_spline_coefficients(xVals.size(), a.data(),
-                                    b.data(), c.data(), d.data(),
-                                    xVals.data(), tempYVals.data(), w.data());
-    for(size_t idx = 0; idx < xVals.size(); ++idx)
+    calculateCoefs(math::cubic_spline_fitter<double>(m_xVals.size(), m_xVals.data(), tempYVals.data()),
+                   fSmoothParam);
+}
+
+StandartPeacewisePoly::StandartPeacewisePoly(const math::cubic_spline_fitter<double>& fitter, double fSmoothParam,
+                                             std::size_t nWindowSize)
+    :
+      PeacewisePoly(3, fitter.size()),
+      m_xVals(fitter.x()),
+      m_fStep(0.0)
+{
+    calculateCoefs(fitter, fSmoothParam, nWindowSize);
+}
+
+void StandartPeacewisePoly::calculateCoefs(const math::cubic_spline_fitter<double>& fitter, double fSmoothParam,
+                                           std::size_t nWindowSize)
+{
+    Vector  a(fitter.size()),
+            b(fitter.size()),
+            c(fitter.size()),
+            d(fitter.size());
+    if(nWindowSize) fitter.fit_segmented(fSmoothParam, a.data(), b.data(), c.data(), d.data(), nWindowSize);
+    else fitter.fit(fSmoothParam, a.data(), b.data(), c.data(), d.data());
+    for(size_t idx = 0; idx < fitter.size(); ++idx)
     {
         coefs()[4*idx]     = d[idx]/6.;
         coefs()[4*idx + 1] = c[idx]/2.;
         coefs()[4*idx + 2] = b[idx];
         coefs()[4*idx + 3] = a[idx];
     }
+
+    //Equally spaced x-values allow constant time interval search
+    double fStart, h;
+    if(math::uniform_grid(m_xVals.data(), m_xVals.size(), fStart, h)) m_fStep = h;
 }
 
 PeacewisePoly::PolyType StandartPeacewisePoly::type() const
@@ -76,6 +191,12 @@ PeacewisePoly::PolyType StandartPeacewisePoly::type() const
 
 std::size_t StandartPeacewisePoly::findInterval(double x) const
 {
+    if(m_fStep > 0.0)
+    {
+        double dx = x - xMin();
+        size_t n = size_t(dx / m_fStep);
+        return dx < 0 ? 0 : (n >= nSteps() ? nSteps() - 1 : n);
+    }
     auto it = std::lower_bound(m_xVals.begin(), m_xVals.end(), x);
     if(it == m_xVals.begin()) return 0;
     else return std::distance(m_xVals.begin(), std::prev(it));
@@ -86,6 +207,33 @@ double StandartPeacewisePoly::findDxValue(double x, size_t idx) const
     return x - m_xVals[idx];
 }
 
+void StandartPeacewisePoly::findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const
+{
+    if(m_fStep > 0.0 || !std::is_sorted(pX, pX + n))
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            pIdx[i] = StandartPeacewisePoly::findInterval(pX[i]);
+            pDx[i] = pX[i] - m_xVals[pIdx[i]];
+        }
+        return;
+    }
+
+    //Sorted x-values are merged with the knots
+    auto it = m_xVals.cbegin();
+    for(size_t i = 0; i < n; ++i)
+    {
+        it = math::gallop_lower_bound(it, m_xVals.cend(), pX[i]);
+        pIdx[i] = it == m_xVals.cbegin() ? 0 : std::distance(m_xVals.cbegin(), it) - 1;
+        pDx[i] = pX[i] - m_xVals[pIdx[i]];
+    }
+}
+
+void StandartPeacewisePoly::intervalStarts(size_t idx, size_t n, double* pStarts) const
+{
+    std::copy(m_xVals.begin() + idx, m_xVals.begin() + idx + n, pStarts);
+}
+
 EqualStepPeacewisePoly::EqualStepPeacewisePoly(const StandartPeacewisePoly &poly,
                                                double h)
     :
@@ -124,3 +272,17 @@ double EqualStepPeacewisePoly::findDxValue(double x, size_t idx) const
 {
     return x - m_fXMin - m_fH * idx;
 }
+
+void EqualStepPeacewisePoly::findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        pIdx[i] = EqualStepPeacewisePoly::findInterval(pX[i]);
+        pDx[i] = pX[i] - m_fXMin - m_fH * pIdx[i];
+    }
+}
+
+void EqualStepPeacewisePoly::intervalStarts(size_t idx, size_t n, double* pStarts) const
+{
+    for(size_t i = 0; i < n; ++i) pStarts[i] = m_fXMin + m_fH * (idx + i);
+}
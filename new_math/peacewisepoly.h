@@ -6,6 +6,11 @@
 
 #define MAX_SPLINE_STEPS
 
+namespace math
+{
+    template<typename Float> class cubic_spline_fitter;
+}
+
 /**
  * Interface to peacewise polynomial class
  */
@@ -53,6 +58,43 @@ public:
         return estimateSpline(idx, findDxValue(x, idx));
     }
 
+    /**
+     * @brief operator () evaluates the polynomial at n x-values at once using vector instructions,
+     * intervals of sorted x-values are found by a single walk along the knots
+     * @param pX x-values
+     * @param pY storage for n y-values
+     * @param n
+     */
+    void operator()(const double* pX, double* pY, size_t n) const;
+
+    /**
+     * @brief operator ()
+     * @param vXVals
+     * @return Y-values correspondent to given X-values
+     */
+    Vector operator()(const Vector& vXVals) const;
+
+    /**
+     * @brief findMaxs looks for maximums between the first and the last knots in closed form,
+     * polynomials of degrees higher than three have no maximums found
+     * @param vXVals positions of maximums in ascending order
+     * @param vYVals values of the polynomial at maximums
+     */
+    void findMaxs(Vector& vXVals, Vector& vYVals) const;
+
+    /**
+     * @brief findPiecesMaxs looks for maximums of n subsequent pieces of degree two or three given by
+     * coefficients, e.g. of a part of a polynomial fitted separately
+     * @param pCoefs coefficients stored one piece after another, the highest power first
+     * @param nDegree
+     * @param pStarts x-values at which n + 1 subsequent pieces start
+     * @param n
+     * @param vXVals positions of found maximums are appended to it
+     * @param vYVals values at found maximums are appended to it
+     */
+    static void findPiecesMaxs(const double* pCoefs, uint8_t nDegree, const double* pStarts, size_t n,
+                               Vector& vXVals, Vector& vYVals);
+
     /**
      * @brief nSteps
      * @return Number of intervals in polynomial
@@ -83,6 +125,24 @@ protected:
      */
     virtual double findDxValue(double x, size_t idx) const = 0;
 
+    /**
+     * @brief findIntervals looks for intervals and delta x values of n x-values at once,
+     * derived classes override it to avoid virtual calls per value
+     * @param pX x-values
+     * @param n
+     * @param pIdx storage for n interval indices
+     * @param pDx storage for n delta x values
+     */
+    virtual void findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const;
+
+    /**
+     * @brief intervalStarts returns x-values at which n subsequent intervals start
+     * @param idx index of the first interval
+     * @param n
+     * @param pStarts storage for n x-values
+     */
+    virtual void intervalStarts(size_t idx, size_t n, double* pStarts) const = 0;
+
     /**
      * @brief intervalCoefs returns coefficients for interval index idx
      * @param idx
@@ -129,19 +189,49 @@ public:
                           const Vector& yVals,
                           double fSmoothParam = 0.0);
 
+    /**
+     * @brief StandartPeacewisePoly calculates spline using prepared fitting of sorted data,
+     * only the smoothing dependent part of spline equations is solved
+     * @param fitter
+     * @param fSmoothParam smoothing parameter for the spline line
+     * @param nWindowSize if it is not zero, data longer than it are fitted by overlapping windows
+     * of this number of points
+     */
+    StandartPeacewisePoly(const math::cubic_spline_fitter<double>& fitter,
+                          double fSmoothParam,
+                          std::size_t nWindowSize = 0);
+
     virtual PolyType type() const;
 
     inline double xMin() const { return *m_xVals.begin(); }
 
     inline double xMax() const { return *m_xVals.rbegin(); }
 
+    /**
+     * @brief step
+     * @return step between equally spaced x-values or zero if they are not equally spaced
+     */
+    inline double step() const { return m_fStep; }
+
 protected:
     size_t findInterval(double x) const;
 
     double findDxValue(double x, size_t idx) const;
 
+    void findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const;
+
+    void intervalStarts(size_t idx, size_t n, double* pStarts) const;
+
 private:
     Vector m_xVals;
+    double m_fStep;
+
+    /**
+     * @brief calculateCoefs fits coefficients to x-values of the fitting
+     * and checks if they are equally spaced
+     */
+    void calculateCoefs(const math::cubic_spline_fitter<double>& fitter, double fSmoothParam,
+                        std::size_t nWindowSize = 0);
 };
 
 /**
@@ -164,6 +254,10 @@ protected:
 
     double findDxValue(double x, size_t idx) const;
 
+    void findIntervals(const double* pX, size_t n, size_t* pIdx, double* pDx) const;
+
+    void intervalStarts(size_t idx, size_t n, double* pStarts) const;
+
 private:
     double m_fH;
     double m_fXMin, m_fXMax;
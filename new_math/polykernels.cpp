@@ -0,0 +1,105 @@
+#include "polykernels.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define POLY_KERNELS_X86
+#endif
+
+namespace
+{
+    using HornerKernel = void (*)(const double*, unsigned, const std::size_t*, const double*, double*, std::size_t);
+
+    void hornerScalar(const double* pCoefs, unsigned nDegree,
+                      const std::size_t* pIdx, const double* pT, double* pY, std::size_t n)
+    {
+        const std::size_t nStride = nDegree + 1;
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            const double* c = pCoefs + pIdx[i] * nStride;
+            double res = c[0];
+            for(unsigned k = 1; k <= nDegree; ++k) res = res * pT[i] + c[k];
+            pY[i] = res;
+        }
+    }
+
+#ifdef POLY_KERNELS_X86
+    //Offsets of coefficients are products of 32-bit piece indices and the stride
+
+    __attribute__((target("avx2,fma")))
+    void hornerAVX2(const double* pCoefs, unsigned nDegree,
+                    const std::size_t* pIdx, const double* pT, double* pY, std::size_t n)
+    {
+        const __m256i vStride = _mm256_set1_epi64x(nDegree + 1);
+        std::size_t i = 0;
+        for(; i + 4 <= n; i += 4)
+        {
+            __m256i vOffs = _mm256_mul_epu32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIdx + i)), vStride);
+            __m256d vT = _mm256_loadu_pd(pT + i);
+            __m256d vRes = _mm256_i64gather_pd(pCoefs, vOffs, 8);
+            for(unsigned k = 1; k <= nDegree; ++k)
+                vRes = _mm256_fmadd_pd(vRes, vT, _mm256_i64gather_pd(pCoefs + k, vOffs, 8));
+            _mm256_storeu_pd(pY + i, vRes);
+        }
+        hornerScalar(pCoefs, nDegree, pIdx + i, pT + i, pY + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    void hornerAVX512(const double* pCoefs, unsigned nDegree,
+                      const std::size_t* pIdx, const double* pT, double* pY, std::size_t n)
+    {
+        //Masked forms with all lanes set avoid undefined sources of the unmasked intrinsics
+        const __mmask8 all = 0xFF;
+        const __m512i vStride = _mm512_set1_epi64(nDegree + 1);
+        const __m512d vZero = _mm512_setzero_pd();
+        std::size_t i = 0;
+        for(; i + 8 <= n; i += 8)
+        {
+            __m512i vOffs = _mm512_maskz_mul_epu32(all, _mm512_loadu_si512(pIdx + i), vStride);
+            __m512d vT = _mm512_loadu_pd(pT + i);
+            __m512d vRes = _mm512_mask_i64gather_pd(vZero, all, vOffs, pCoefs, 8);
+            for(unsigned k = 1; k <= nDegree; ++k)
+                vRes = _mm512_fmadd_pd(vRes, vT, _mm512_mask_i64gather_pd(vZero, all, vOffs, pCoefs + k, 8));
+            _mm512_storeu_pd(pY + i, vRes);
+        }
+        hornerScalar(pCoefs, nDegree, pIdx + i, pT + i, pY + i, n - i);
+    }
+#endif
+
+    HornerKernel chooseHorner()
+    {
+        switch(poly_kernels::instructionSet())
+        {
+#ifdef POLY_KERNELS_X86
+        case poly_kernels::AVX512Set:
+            return hornerAVX512;
+        case poly_kernels::AVX2Set:
+            return hornerAVX2;
+#endif
+        default:
+            return hornerScalar;
+        }
+    }
+}
+
+poly_kernels::InstructionSet poly_kernels::instructionSet()
+{
+#ifdef POLY_KERNELS_X86
+    static const InstructionSet set = []() -> InstructionSet
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")) return AVX512Set;
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return AVX2Set;
+        return ScalarSet;
+    }();
+    return set;
+#else
+    return ScalarSet;
+#endif
+}
+
+void poly_kernels::horner(const double* pCoefs, unsigned nDegree,
+                          const std::size_t* pIdx, const double* pT, double* pY, std::size_t n)
+{
+    static const HornerKernel kernel = chooseHorner();
+    kernel(pCoefs, nDegree, pIdx, pT, pY, n);
+}
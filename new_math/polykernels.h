@@ -0,0 +1,39 @@
+#ifndef POLYKERNELS_H
+#define POLYKERNELS_H
+
+#include <cstddef>
+
+/**
+ * Batched evaluation kernels for peacewise polynomials. Kernels are compiled for
+ * several instruction sets, the best one supported by the processor is chosen at runtime
+ */
+namespace poly_kernels
+{
+    ///Instruction sets kernels are compiled for
+    enum InstructionSet
+    {
+        ScalarSet, ///<Plain C++ code
+        AVX2Set, ///<4 double lanes with FMA
+        AVX512Set ///<8 double lanes with FMA
+    };
+
+    /**
+     * @brief instructionSet
+     * @return instruction set used by the kernels on this processor
+     */
+    InstructionSet instructionSet();
+
+    /**
+     * @brief horner evaluates n polynomial pieces by the Horner scheme
+     * @param pCoefs coefficients of pieces stored one piece after another, the highest power first
+     * @param nDegree degree of every piece
+     * @param pIdx indices of pieces to evaluate, they should be less than 2^32
+     * @param pT arguments of the pieces
+     * @param pY storage for n results
+     * @param n
+     */
+    void horner(const double* pCoefs, unsigned nDegree,
+                const std::size_t* pIdx, const double* pT, double* pY, std::size_t n);
+}
+
+#endif // POLYKERNELS_H